@@ -0,0 +1,434 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file audio.cpp Implementation of inspecting raw PCM data
+ *
+ * All PCM data is handled as signed 16 bits levels; 8 bits data is
+ * unsigned, so it is converted by subtracting 128. Where SSE2 is available
+ * the bulk of the data is handled 8 levels at a time, and the remainder by
+ * the plain implementation, which gives exactly the same results.
+ */
+
+#include "stdafx.h"
+#include "audio.hpp"
+#include <bit>
+#include <climits>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define WITH_SSE2
+	#include <emmintrin.h>
+#endif
+
+/** Properties of the PCM format needed to analyze the levels. */
+struct LevelLimits {
+	int16_t lowest;    ///< The lowest possible level
+	int16_t highest;   ///< The highest possible level
+	int16_t threshold; ///< The highest absolute level that is still silent
+};
+
+/** Running totals of the analysis, in the units of the PCM format. */
+struct LevelTotals {
+	int64_t sum = 0;          ///< Sum of the levels
+	uint64_t sum_squares = 0; ///< Sum of the squares of the levels
+	int32_t min = INT_MAX;    ///< Lowest level
+	int32_t max = INT_MIN;    ///< Highest level
+	uint64_t clipped = 0;     ///< Number of levels at the lowest or highest possible level
+	uint64_t loud = 0;        ///< Number of levels above the silence threshold
+};
+
+/**
+ * Get the limits of a PCM format.
+ * @param bits_per_sample   the number of bits per sample
+ * @param silence_threshold the level in dBFS below which a frame is silent
+ * @return the limits
+ */
+static LevelLimits GetLevelLimits(uint16_t bits_per_sample, double silence_threshold)
+{
+	double full_scale = bits_per_sample == 16 ? 32768.0 : 128.0;
+	double threshold = std::min(full_scale * std::pow(10.0, silence_threshold / 20.0), full_scale - 1);
+
+	LevelLimits limits;
+	limits.lowest    = bits_per_sample == 16 ? INT16_MIN : -128;
+	limits.highest   = bits_per_sample == 16 ? INT16_MAX : 127;
+	limits.threshold = (int16_t)threshold;
+	return limits;
+}
+
+/**
+ * Get the level of a single frame.
+ * @param data            the PCM data
+ * @param index           the index of the frame
+ * @param bits_per_sample the number of bits per sample
+ * @return the level
+ */
+static inline int16_t GetLevel(const uint8_t *data, size_t index, uint16_t bits_per_sample)
+{
+	if (bits_per_sample == 16) return (int16_t)(data[index * 2] | data[index * 2 + 1] << 8);
+	return (int16_t)(data[index] - 128);
+}
+
+/**
+ * Check whether a level is above the silence threshold.
+ * @param level  the level
+ * @param limits the limits of the PCM format
+ * @return true if the level is audible
+ */
+static inline bool IsAudible(int16_t level, const LevelLimits &limits)
+{
+	return level > limits.threshold || level < -limits.threshold;
+}
+
+/**
+ * Scale a level to the 8 bits signed levels of a waveform overview.
+ * @param level           the level
+ * @param bits_per_sample the number of bits per sample
+ * @return the scaled level
+ */
+static inline int8_t ToWaveformLevel(int16_t level, uint16_t bits_per_sample)
+{
+	return (int8_t)(bits_per_sample == 16 ? level >> 8 : level);
+}
+
+/**
+ * Get the waveform bin of frames one at a time.
+ * @param data            the PCM data
+ * @param begin           the first frame of the bin
+ * @param end             the frame after the last frame of the bin
+ * @param bits_per_sample the number of bits per sample
+ * @return the bin
+ */
+static WaveformBin GetWaveformBin(const uint8_t *data, size_t begin, size_t end, uint16_t bits_per_sample)
+{
+	int16_t min = INT16_MAX;
+	int16_t max = INT16_MIN;
+	for (size_t i = begin; i < end; i++) {
+		int16_t level = GetLevel(data, i, bits_per_sample);
+		min = std::min(min, level);
+		max = std::max(max, level);
+	}
+	return { ToWaveformLevel(min, bits_per_sample), ToWaveformLevel(max, bits_per_sample) };
+}
+
+/**
+ * Analyze frames one at a time.
+ * @param data            the PCM data
+ * @param begin           the first frame to analyze
+ * @param end             the frame after the last frame to analyze
+ * @param bits_per_sample the number of bits per sample
+ * @param limits          the limits of the PCM format
+ * @param totals          the totals to add the frames to
+ */
+static void AnalyzeLevels(const uint8_t *data, size_t begin, size_t end, uint16_t bits_per_sample, const LevelLimits &limits, LevelTotals &totals)
+{
+	for (size_t i = begin; i < end; i++) {
+		int32_t level = GetLevel(data, i, bits_per_sample);
+		totals.sum += level;
+		totals.sum_squares += (uint64_t)(level * level);
+		totals.min = std::min(totals.min, level);
+		totals.max = std::max(totals.max, level);
+		if (level == limits.lowest || level == limits.highest) totals.clipped++;
+		if (IsAudible(level, limits)) totals.loud++;
+	}
+}
+
+#if defined(WITH_SSE2)
+/**
+ * Number of 16 byte vectors to handle before moving the narrow per-lane
+ * counters to the totals, so they cannot overflow.
+ */
+static const size_t VECTORS_PER_BLOCK = 8192;
+
+/**
+ * Get the sum of the 32 bits lanes of a vector.
+ * @param v the vector
+ * @return the sum
+ */
+static inline int64_t SumLanes32(__m128i v)
+{
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, v);
+	return (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+/**
+ * Get the sum of the unsigned 16 bits lanes of a vector.
+ * @param v the vector
+ * @return the sum
+ */
+static inline uint64_t SumLanes16(__m128i v)
+{
+	uint16_t lanes[8];
+	_mm_storeu_si128((__m128i *)lanes, v);
+	uint64_t sum = 0;
+	for (uint16_t lane : lanes) sum += lane;
+	return sum;
+}
+
+/**
+ * Analyze as many frames as possible 16 bytes at a time.
+ * @param data            the PCM data
+ * @param frames          the number of frames
+ * @param bits_per_sample the number of bits per sample
+ * @param limits          the limits of the PCM format
+ * @param totals          the totals to add the frames to
+ * @return the number of analyzed frames
+ */
+static size_t AnalyzeVectors(const uint8_t *data, size_t frames, uint16_t bits_per_sample, const LevelLimits &limits, LevelTotals &totals)
+{
+	const size_t frames_per_vector = bits_per_sample == 16 ? 8 : 16;
+	const size_t vectors = frames / frames_per_vector;
+
+	const __m128i zero     = _mm_setzero_si128();
+	const __m128i ones     = _mm_set1_epi16(1);
+	const __m128i bias     = _mm_set1_epi16(128);
+	const __m128i lowest   = _mm_set1_epi16(limits.lowest);
+	const __m128i highest  = _mm_set1_epi16(limits.highest);
+	const __m128i above    = _mm_set1_epi16(limits.threshold);
+	const __m128i below    = _mm_set1_epi16(-limits.threshold);
+
+	__m128i min = _mm_set1_epi16(INT16_MAX);
+	__m128i max = _mm_set1_epi16(INT16_MIN);
+	__m128i squares = zero;
+
+	for (size_t done = 0; done < vectors; ) {
+		size_t end = std::min(vectors, done + VECTORS_PER_BLOCK);
+
+		__m128i sum = zero;
+		__m128i clipped = zero;
+		__m128i loud = zero;
+
+		auto analyze = [&](__m128i levels) {
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(levels, ones));
+
+			/* The pairwise sum of squares is at most 2^31, so it fits when seen as unsigned. */
+			__m128i square = _mm_madd_epi16(levels, levels);
+			squares = _mm_add_epi64(squares, _mm_add_epi64(_mm_unpacklo_epi32(square, zero), _mm_unpackhi_epi32(square, zero)));
+
+			min = _mm_min_epi16(min, levels);
+			max = _mm_max_epi16(max, levels);
+
+			/* Comparisons yield -1 for every matching lane. */
+			clipped = _mm_sub_epi16(clipped, _mm_or_si128(_mm_cmpeq_epi16(levels, lowest), _mm_cmpeq_epi16(levels, highest)));
+			loud    = _mm_sub_epi16(loud,    _mm_or_si128(_mm_cmpgt_epi16(levels, above),  _mm_cmplt_epi16(levels, below)));
+		};
+
+		for (; done < end; done++) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(data + done * 16));
+			if (bits_per_sample == 16) {
+				analyze(v);
+			} else {
+				analyze(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias));
+				analyze(_mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias));
+			}
+		}
+
+		totals.sum     += SumLanes32(sum);
+		totals.clipped += SumLanes16(clipped);
+		totals.loud    += SumLanes16(loud);
+	}
+
+	uint64_t square_lanes[2];
+	_mm_storeu_si128((__m128i *)square_lanes, squares);
+	totals.sum_squares += square_lanes[0] + square_lanes[1];
+
+	int16_t min_lanes[8], max_lanes[8];
+	_mm_storeu_si128((__m128i *)min_lanes, min);
+	_mm_storeu_si128((__m128i *)max_lanes, max);
+	for (int i = 0; i < 8 && vectors != 0; i++) {
+		totals.min = std::min<int32_t>(totals.min, min_lanes[i]);
+		totals.max = std::max<int32_t>(totals.max, max_lanes[i]);
+	}
+
+	return vectors * frames_per_vector;
+}
+
+/**
+ * Get a bit mask of the bytes of 16 bytes of PCM data that belong to audible frames.
+ * @param data            the PCM data
+ * @param bits_per_sample the number of bits per sample
+ * @param limits          the limits of the PCM format
+ * @return the mask; one bit per byte, so two bits per frame for 16 bits PCM
+ */
+static inline uint32_t GetAudibleMask(const uint8_t *data, uint16_t bits_per_sample, const LevelLimits &limits)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)data);
+	__m128i audible;
+	if (bits_per_sample == 16) {
+		audible = _mm_or_si128(_mm_cmpgt_epi16(v, _mm_set1_epi16(limits.threshold)), _mm_cmplt_epi16(v, _mm_set1_epi16(-limits.threshold)));
+	} else {
+		/* Flipping the top bit turns unsigned levels into signed levels. */
+		v = _mm_xor_si128(v, _mm_set1_epi8((char)0x80));
+		audible = _mm_or_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)limits.threshold)), _mm_cmplt_epi8(v, _mm_set1_epi8((char)-limits.threshold)));
+	}
+	return (uint32_t)_mm_movemask_epi8(audible);
+}
+
+/**
+ * Get as many complete waveform bins as possible 16 bytes at a time.
+ * @param data            the PCM data
+ * @param frames          the number of frames
+ * @param bits_per_sample the number of bits per sample
+ * @param bins            the bins to fill
+ * @return the number of filled bins
+ */
+static size_t WaveformVectors(const uint8_t *data, size_t frames, uint16_t bits_per_sample, WaveformBin *bins)
+{
+	const size_t vectors_per_bin = WAVEFORM_BIN_FRAMES * (bits_per_sample == 16 ? 2 : 1) / 16;
+	const size_t count = frames / WAVEFORM_BIN_FRAMES;
+
+	for (size_t bin = 0; bin < count; bin++) {
+		const uint8_t *begin = data + bin * vectors_per_bin * 16;
+
+		if (bits_per_sample == 16) {
+			__m128i min = _mm_set1_epi16(INT16_MAX);
+			__m128i max = _mm_set1_epi16(INT16_MIN);
+			for (size_t i = 0; i < vectors_per_bin; i++) {
+				__m128i v = _mm_loadu_si128((const __m128i *)(begin + i * 16));
+				min = _mm_min_epi16(min, v);
+				max = _mm_max_epi16(max, v);
+			}
+
+			int16_t min_lanes[8], max_lanes[8];
+			_mm_storeu_si128((__m128i *)min_lanes, min);
+			_mm_storeu_si128((__m128i *)max_lanes, max);
+			bins[bin] = { ToWaveformLevel(*std::min_element(min_lanes, min_lanes + 8), 16), ToWaveformLevel(*std::max_element(max_lanes, max_lanes + 8), 16) };
+		} else {
+			/* There are only unsigned byte comparisons, which suit 8 bits PCM just fine. */
+			__m128i min = _mm_set1_epi8((char)0xFF);
+			__m128i max = _mm_setzero_si128();
+			for (size_t i = 0; i < vectors_per_bin; i++) {
+				__m128i v = _mm_loadu_si128((const __m128i *)(begin + i * 16));
+				min = _mm_min_epu8(min, v);
+				max = _mm_max_epu8(max, v);
+			}
+
+			uint8_t min_lanes[16], max_lanes[16];
+			_mm_storeu_si128((__m128i *)min_lanes, min);
+			_mm_storeu_si128((__m128i *)max_lanes, max);
+			bins[bin] = { (int8_t)(*std::min_element(min_lanes, min_lanes + 16) - 128), (int8_t)(*std::max_element(max_lanes, max_lanes + 16) - 128) };
+		}
+	}
+
+	return count;
+}
+#endif /* WITH_SSE2 */
+
+AudioStats AnalyzeAudio(const uint8_t *data, size_t amount, uint16_t bits_per_sample, double silence_threshold)
+{
+	const size_t frames = bits_per_sample == 16 ? amount / 2 : amount;
+	const LevelLimits limits = GetLevelLimits(bits_per_sample, silence_threshold);
+
+	LevelTotals totals;
+	size_t done = 0;
+#if defined(WITH_SSE2)
+	done = AnalyzeVectors(data, frames, bits_per_sample, limits, totals);
+#endif
+	AnalyzeLevels(data, done, frames, bits_per_sample, limits, totals);
+
+	AudioStats stats;
+	stats.frames = frames;
+	if (frames == 0) return stats;
+
+	double full_scale = bits_per_sample == 16 ? 32768.0 : 128.0;
+	stats.peak          = std::max(-totals.min, totals.max) / full_scale;
+	stats.rms           = std::sqrt((double)totals.sum_squares / frames) / full_scale;
+	stats.dc_offset     = ((double)totals.sum / frames) / full_scale;
+	stats.clipped       = totals.clipped;
+	stats.silence_ratio = (double)(frames - totals.loud) / frames;
+	return stats;
+}
+
+std::pair<size_t, size_t> FindAudibleFrames(const uint8_t *data, size_t amount, uint16_t bits_per_sample, double silence_threshold)
+{
+	const size_t frames = bits_per_sample == 16 ? amount / 2 : amount;
+	const size_t bytes_per_frame = bits_per_sample == 16 ? 2 : 1;
+	const LevelLimits limits = GetLevelLimits(bits_per_sample, silence_threshold);
+
+	/* Scan forward for the first audible frame. */
+	size_t first = 0;
+#if defined(WITH_SSE2)
+	const size_t frames_per_vector = 16 / bytes_per_frame;
+	for (; first + frames_per_vector <= frames; first += frames_per_vector) {
+		uint32_t mask = GetAudibleMask(data + first * bytes_per_frame, bits_per_sample, limits);
+		if (mask != 0) {
+			first += std::countr_zero(mask) / bytes_per_frame;
+			break;
+		}
+	}
+#endif
+	while (first < frames && !IsAudible(GetLevel(data, first, bits_per_sample), limits)) first++;
+	if (first == frames) return { 0, 0 };
+
+	/* Scan backward for the last audible frame; there is one, so this stops before first. */
+	size_t end = frames;
+#if defined(WITH_SSE2)
+	for (; end >= first + frames_per_vector; end -= frames_per_vector) {
+		uint32_t mask = GetAudibleMask(data + (end - frames_per_vector) * bytes_per_frame, bits_per_sample, limits);
+		if (mask != 0) {
+			end -= (size_t)std::countl_zero(mask << 16) / bytes_per_frame;
+			return { first, end };
+		}
+	}
+#endif
+	while (!IsAudible(GetLevel(data, end - 1, bits_per_sample), limits)) end--;
+	return { first, end };
+}
+
+std::vector<WaveformLevel> ComputeWaveform(const uint8_t *data, size_t amount, uint16_t bits_per_sample)
+{
+	const size_t frames = bits_per_sample == 16 ? amount / 2 : amount;
+
+	std::vector<WaveformLevel> levels(1);
+	WaveformLevel &first = levels.front();
+	first.frames_per_bin = WAVEFORM_BIN_FRAMES;
+	first.bins.resize((frames + WAVEFORM_BIN_FRAMES - 1) / WAVEFORM_BIN_FRAMES);
+
+	size_t done = 0;
+#if defined(WITH_SSE2)
+	done = WaveformVectors(data, frames, bits_per_sample, first.bins.data());
+#endif
+	for (size_t bin = done; bin < first.bins.size(); bin++) {
+		first.bins[bin] = GetWaveformBin(data, bin * WAVEFORM_BIN_FRAMES, std::min<size_t>(frames, (bin + 1) * WAVEFORM_BIN_FRAMES), bits_per_sample);
+	}
+
+	/* Every next level is made from the level before it, so the data is only inspected once. */
+	while (levels.back().bins.size() > 1) {
+		const WaveformLevel &previous = levels.back();
+
+		WaveformLevel level;
+		level.frames_per_bin = previous.frames_per_bin * WAVEFORM_ZOOM;
+		level.bins.resize((previous.bins.size() + WAVEFORM_ZOOM - 1) / WAVEFORM_ZOOM);
+		for (size_t bin = 0; bin < level.bins.size(); bin++) {
+			auto begin = previous.bins.begin() + bin * WAVEFORM_ZOOM;
+			auto end = previous.bins.begin() + std::min<size_t>(previous.bins.size(), (bin + 1) * WAVEFORM_ZOOM);
+
+			level.bins[bin] = *begin;
+			for (auto iter = begin + 1; iter != end; ++iter) {
+				level.bins[bin].min = std::min(level.bins[bin].min, iter->min);
+				level.bins[bin].max = std::max(level.bins[bin].max, iter->max);
+			}
+		}
+		levels.push_back(std::move(level));
+	}
+
+	return levels;
+}
@@ -0,0 +1,100 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file audio.hpp Interface for inspecting raw PCM data */
+
+#ifndef AUDIO_HPP
+#define AUDIO_HPP
+
+#include <vector>
+
+/** Level, in dBFS, below which audio is considered silent unless told otherwise. */
+static const double DEFAULT_SILENCE_THRESHOLD = -40.0;
+
+/**
+ * Statistics about the audio in a block of PCM data. All levels are
+ * relative to full scale, i.e. 1.0 is the loudest possible level.
+ */
+struct AudioStats {
+	uint64_t frames = 0;       ///< Number of frames
+	double peak = 0;           ///< Highest absolute level
+	double rms = 0;            ///< Root mean square of the levels
+	double dc_offset = 0;      ///< Mean of the levels
+	uint64_t clipped = 0;      ///< Number of frames at the lowest or highest possible level
+	double silence_ratio = 0;  ///< Part of the frames that is below the silence threshold
+};
+
+/** Number of frames in a bin of the most detailed level of a waveform overview. */
+static const uint32_t WAVEFORM_BIN_FRAMES = 256;
+
+/** Factor by which every level of a waveform overview has fewer bins than the level before it. */
+static const uint32_t WAVEFORM_ZOOM = 4;
+
+/**
+ * The lowest and highest level of the frames in a bin of a waveform
+ * overview, scaled to 8 bits signed levels whatever the PCM format.
+ */
+struct WaveformBin {
+	int8_t min; ///< Lowest level
+	int8_t max; ///< Highest level
+};
+
+/**
+ * A single level of a waveform overview.
+ */
+struct WaveformLevel {
+	uint32_t frames_per_bin = 0;  ///< Number of frames in every bin; the last bin may have less
+	std::vector<WaveformBin> bins; ///< The bins from the begin to the end of the audio
+};
+
+/**
+ * Get the statistics about a block of mono PCM data.
+ * @param data              the PCM data
+ * @param amount            the amount of bytes of PCM data
+ * @param bits_per_sample   8 for unsigned 8 bits PCM, 16 for signed little endian 16 bits PCM
+ * @param silence_threshold the level in dBFS below which a frame is silent
+ * @return the statistics
+ */
+AudioStats AnalyzeAudio(const uint8_t *data, size_t amount, uint16_t bits_per_sample, double silence_threshold);
+
+/**
+ * Find the audible part of a block of mono PCM data, i.e. the part between
+ * the leading and the trailing silence.
+ * @param data              the PCM data
+ * @param amount            the amount of bytes of PCM data
+ * @param bits_per_sample   8 for unsigned 8 bits PCM, 16 for signed little endian 16 bits PCM
+ * @param silence_threshold the level in dBFS below which a frame is silent
+ * @return the first audible frame and the frame after the last audible frame; both 0 when everything is silent
+ */
+std::pair<size_t, size_t> FindAudibleFrames(const uint8_t *data, size_t amount, uint16_t bits_per_sample, double silence_threshold);
+
+/**
+ * Get the waveform overview of a block of mono PCM data. The first level
+ * has WAVEFORM_BIN_FRAMES frames per bin, and every next level combines
+ * WAVEFORM_ZOOM bins of the level before it, up to the level with a
+ * single bin.
+ * @param data            the PCM data
+ * @param amount          the amount of bytes of PCM data
+ * @param bits_per_sample 8 for unsigned 8 bits PCM, 16 for signed little endian 16 bits PCM
+ * @return the levels, from the most to the least detailed
+ */
+std::vector<WaveformLevel> ComputeWaveform(const uint8_t *data, size_t amount, uint16_t bits_per_sample);
+
+#endif /* AUDIO_HPP */
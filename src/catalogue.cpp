@@ -0,0 +1,207 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file catalogue.cpp Implementation of indexing and splicing cat files */
+
+#include "stdafx.h"
+#include "catalogue.hpp"
+#include "schema.hpp"
+
+bool _direct = false;
+
+std::unique_ptr<Reader> OpenCatReader(const std::string &filename)
+{
+	if (_direct) return std::make_unique<DirectReader>(filename);
+	return std::make_unique<PositionalReader>(filename, AccessHint::Sequential);
+}
+
+Catalogue::Catalogue(Reader &reader) : reader(reader)
+{
+	uint8_t buffer[CatHeaderEntry::Layout::size];
+	reader.ReadRaw(buffer, sizeof(buffer));
+
+	uint32_t count = CatHeaderEntry::Offset::Unpack(buffer);
+	this->new_format = (count & CatHeaderEntry::NEW_FORMAT) != 0;
+	count &= CatHeaderEntry::OFFSET_MASK;
+	count /= CatHeaderEntry::Layout::size;
+
+	reader.Seek(0);
+	this->entries.resize(count);
+	for (CatEntry &entry : this->entries) {
+		reader.ReadRaw(buffer, sizeof(buffer));
+		entry.offset = CatHeaderEntry::Offset::Unpack(buffer) & CatHeaderEntry::OFFSET_MASK;
+		entry.size   = CatHeaderEntry::Size::Unpack(buffer);
+	}
+
+	uint32_t index = 0;
+	for (CatEntry &entry : this->entries) {
+		if (reader.GetPos() != entry.offset) throw "Invalid offset in file " + reader.GetFilename();
+
+		entry.name = StringRecord::Read(reader);
+		entry.data_offset = static_cast<uint32_t>(reader.GetPos());
+
+		/* Only peek at the payload to know whether it has RIFF headers. */
+		reader.ReadRaw(buffer, RiffHeader::ChunkId::size);
+		entry.raw = !RiffHeader::ChunkId::Validate(buffer);
+
+		/* Skip the payload; we only need to know where the entry ends. */
+		reader.Seek((uint64_t)entry.data_offset + entry.size);
+
+		if (this->new_format) {
+			/* Some kind of data byte, unused */
+			reader.ReadByte();
+
+			entry.filename = StringRecord::Read(reader);
+		} else {
+			entry.filename = Sample::ReadOldFormatFilename(reader, entry.name, index);
+		}
+
+		entry.length = reader.GetPos() - entry.offset;
+		index++;
+	}
+}
+
+uint32_t Catalogue::GetCopySize(const CatEntry &entry) const
+{
+	if (this->new_format || !entry.raw) return entry.size;
+
+	/* The raw PCM sample of the old format gets RIFF headers. */
+	if (entry.size > UINT32_MAX - RiffHeader::Layout::size) throw "Sample " + entry.name + " is too large to upgrade";
+	return entry.size + static_cast<uint32_t>(RiffHeader::Layout::size);
+}
+
+uint64_t Catalogue::GetCopyLength(const CatEntry &entry) const
+{
+	if (this->new_format) return entry.length;
+
+	return static_cast<uint64_t>(StringRecord::Size(entry.name)) + this->GetCopySize(entry) + 1 + StringRecord::Size(entry.filename);
+}
+
+void Catalogue::CopyEntry(const CatEntry &entry, Writer &writer) const
+{
+	if (this->new_format) {
+		this->reader.Seek(entry.offset);
+		CopyRaw(this->reader, writer, entry.length);
+		return;
+	}
+
+	uint32_t index = static_cast<uint32_t>(&entry - this->entries.data());
+	this->reader.Seek((uint64_t)index * CatHeaderEntry::Layout::size);
+	Sample sample(this->reader);
+
+	this->reader.Seek(entry.offset);
+	sample.UpgradeCatEntry(this->reader, writer, index);
+}
+
+
+const std::string &CatBuilder::Item::GetName() const
+{
+	return this->sample.has_value() ? this->sample->GetName() : this->entry->name;
+}
+
+void CatBuilder::Put(Item &&item)
+{
+	auto found = this->positions.find(item.GetName());
+	if (found != this->positions.end()) {
+		this->items[found->second] = std::move(item);
+		return;
+	}
+	this->positions.emplace(item.GetName(), this->items.size());
+	this->items.emplace_back(std::move(item));
+}
+
+bool CatBuilder::Contains(const std::string &name) const
+{
+	return this->positions.count(name) != 0;
+}
+
+void CatBuilder::Put(const Catalogue &catalogue, const CatEntry &entry)
+{
+	Item item;
+	item.catalogue = &catalogue;
+	item.entry = &entry;
+	this->Put(std::move(item));
+}
+
+void CatBuilder::Append(const Catalogue &catalogue, const CatEntry &entry)
+{
+	Item item;
+	item.catalogue = &catalogue;
+	item.entry = &entry;
+
+	/* A name that is already known keeps pointing to its first entry. */
+	this->positions.emplace(entry.name, this->items.size());
+	this->items.emplace_back(std::move(item));
+}
+
+void CatBuilder::Put(Sample &&sample)
+{
+	Item item;
+	item.sample.emplace(std::move(sample));
+	this->Put(std::move(item));
+}
+
+bool CatBuilder::Remove(const std::string &name)
+{
+	auto found = this->positions.find(name);
+	if (found == this->positions.end()) return false;
+
+	size_t position = found->second;
+	this->items.erase(this->items.begin() + position);
+	this->positions.erase(found);
+
+	/* Everything after the removed entry moves up one place. */
+	for (auto &entry : this->positions) {
+		if (entry.second > position) entry.second--;
+	}
+	return true;
+}
+
+void CatBuilder::Write(Writer &writer)
+{
+	uint64_t offset = this->items.size() * CatHeaderEntry::Layout::size;
+	for (Item &item : this->items) {
+		if (!CatHeaderEntry::IsValidOffset(offset)) throw "Sample " + item.GetName() + " does not fit in the cat file; the cat format is limited to offsets below 2 GiB";
+
+		uint8_t buffer[CatHeaderEntry::Layout::size];
+		CatHeaderEntry::Offset::Pack(buffer, static_cast<uint32_t>(offset) | CatHeaderEntry::NEW_FORMAT);
+
+		if (item.sample.has_value()) {
+			item.sample->SetOffset(offset);
+			offset = item.sample->GetNextOffset();
+			CatHeaderEntry::Size::Pack(buffer, item.sample->GetSize());
+		} else {
+			offset += item.catalogue->GetCopyLength(*item.entry);
+			CatHeaderEntry::Size::Pack(buffer, item.catalogue->GetCopySize(*item.entry));
+		}
+
+		writer.WriteRaw(buffer, sizeof(buffer));
+	}
+
+	for (const Item &item : this->items) {
+		if (item.sample.has_value()) {
+			item.sample->WriteCatEntry(writer);
+		} else {
+			uint64_t end = writer.GetPos() + item.catalogue->GetCopyLength(*item.entry);
+			item.catalogue->CopyEntry(*item.entry, writer);
+			if (writer.GetPos() != end) throw "Invalid offset when writing file " + writer.GetFilename();
+		}
+	}
+}
@@ -0,0 +1,188 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file catalogue.hpp Interface for indexing and splicing cat files */
+
+#ifndef CATALOGUE_HPP
+#define CATALOGUE_HPP
+
+#include <optional>
+#include <unordered_map>
+#include "sample.hpp"
+
+/** Whether to read cat files without going through the cache of the operating system */
+extern bool _direct;
+
+/**
+ * Open a cat file on disk that is going to be read from begin to end.
+ * Unless it is read directly, its entries can be read in parallel.
+ * @param filename the file to open
+ * @return the reader for the file
+ */
+std::unique_ptr<Reader> OpenCatReader(const std::string &filename);
+
+/**
+ * Location and identification of a single entry within a cat file.
+ */
+struct CatEntry {
+	uint32_t offset = 0;      ///< Offset from the begin of the cat to this entry
+	uint32_t data_offset = 0; ///< Offset from the begin of the cat to the WAV RIFF of this entry
+	uint32_t size = 0;        ///< The size of the WAV RIFF, i.e. excluding name and filename
+	uint64_t length = 0;      ///< The size of the whole entry, i.e. including name and filename
+	bool raw = false;         ///< Whether the payload is raw PCM instead of a WAV RIFF
+
+	std::string name;     ///< The name of the sample
+	std::string filename; ///< The filename of the sample
+};
+
+/**
+ * Index of the entries of a cat file. Only the header table, the names and
+ * the filenames are read; the payloads are never parsed, so entries can be
+ * copied verbatim into another cat file. Entries of a cat file in the old
+ * format are upgraded to the new format while copying them.
+ */
+class Catalogue {
+private:
+	Reader &reader;                ///< The reader of the indexed cat file
+	bool new_format = false;       ///< Whether the cat file is in the new format
+	std::vector<CatEntry> entries; ///< The entries in the order of the header table
+
+public:
+	/**
+	 * Create the index of a cat file.
+	 * Only the layout of the file is checked, i.e. that every entry starts
+	 * where the one before it ends. The payloads, including their RIFF
+	 * headers, are not validated.
+	 * @param reader the cat file to index; must outlive the catalogue
+	 */
+	Catalogue(Reader &reader);
+
+	/**
+	 * Whether the indexed file is in the new format.
+	 * @return true if the file is in the new format
+	 */
+	inline bool IsNewFormat() const { return this->new_format; }
+
+	/**
+	 * Get the entries of the cat file.
+	 * @return the entries in the order of the header table
+	 */
+	inline const std::vector<CatEntry> &GetEntries() const { return this->entries; }
+
+	/**
+	 * Get the size of the WAV RIFF of an entry once it is copied.
+	 * @param entry the entry of this catalogue
+	 * @return the size of the WAV RIFF in the new format
+	 */
+	uint32_t GetCopySize(const CatEntry &entry) const;
+
+	/**
+	 * Get the size of the whole entry once it is copied.
+	 * @param entry the entry of this catalogue
+	 * @return the size of the entry in the new format
+	 */
+	uint64_t GetCopyLength(const CatEntry &entry) const;
+
+	/**
+	 * Copy an entry to a writer; byte for byte when the cat file is in
+	 * the new format, otherwise as upgraded entry in the new format.
+	 * @param entry  the entry of this catalogue to copy
+	 * @param writer the writer to copy the entry to
+	 */
+	void CopyEntry(const CatEntry &entry, Writer &writer) const;
+};
+
+/**
+ * Assembles a new cat file from entries of existing cat files, which are
+ * copied without decoding them, and from samples that have been loaded in memory.
+ * Entries are identified by their name; putting an entry with a name that
+ * is already known replaces the existing entry at the same position.
+ * Appending an entry always adds it, so a cat file can be copied entry for
+ * entry even when names occur multiple times; of those, only the first
+ * entry can be found by its name.
+ */
+class CatBuilder {
+private:
+	/** A single entry of the cat file to write. */
+	struct Item {
+		const Catalogue *catalogue = nullptr; ///< The catalogue to copy the entry from, if any
+		const CatEntry *entry = nullptr;      ///< The entry to copy, if any
+		std::optional<Sample> sample;         ///< The sample to write, if there is no entry to copy
+
+		/**
+		 * Get the name of the sample of this item.
+		 * @return the name of the sample
+		 */
+		const std::string &GetName() const;
+	};
+
+	std::vector<Item> items; ///< The entries of the cat file to write
+	std::unordered_map<std::string, size_t> positions; ///< The position of every entry in items, by name
+
+	/**
+	 * Put an item in the list of entries.
+	 * @param item the item to add or to replace an existing item with
+	 */
+	void Put(Item &&item);
+
+public:
+	/**
+	 * Whether there is an entry with the given name.
+	 * @param name the name of the sample
+	 * @return true if there is such an entry
+	 */
+	bool Contains(const std::string &name) const;
+
+	/**
+	 * Put an entry of an existing cat file.
+	 * @param catalogue the catalogue the entry comes from; must outlive the builder
+	 * @param entry     the entry to copy
+	 */
+	void Put(const Catalogue &catalogue, const CatEntry &entry);
+
+	/**
+	 * Append an entry of an existing cat file after all other entries,
+	 * whether or not there already is an entry with the same name.
+	 * @param catalogue the catalogue the entry comes from; must outlive the builder
+	 * @param entry     the entry to copy
+	 */
+	void Append(const Catalogue &catalogue, const CatEntry &entry);
+
+	/**
+	 * Put a sample loaded in memory.
+	 * @param sample the sample to write
+	 */
+	void Put(Sample &&sample);
+
+	/**
+	 * Remove the entry with the given name.
+	 * @param name the name of the sample
+	 * @return true if the entry was removed
+	 */
+	bool Remove(const std::string &name);
+
+	/**
+	 * Write the assembled cat file.
+	 * @param writer writer for the file
+	 */
+	void Write(Writer &writer);
+};
+
+#endif /* CATALOGUE_HPP */
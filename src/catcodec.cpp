@@ -21,69 +21,237 @@
 /** @file catcodec.cpp Encoding and decoding of "cat" files */
 
 #include "stdafx.h"
+#include <cmath>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
 #include "io.hpp"
 #include "sample.hpp"
+#include "audio.hpp"
+#include "catalogue.hpp"
+#include "diff.hpp"
+#include "parallel.hpp"
+#include "patch.hpp"
+#include "progress.hpp"
+#include "schema.hpp"
+#include "queue.hpp"
+#include "watch.hpp"
+#include "waveform.hpp"
 #include "version.h"
 
 /** Are we run interactively, i.e. from the console, or from a script? */
 static bool _interactive;
 
-/** Show progress, but only on interactive consoles */
-static void ShowProgress()
+/** Maximum amount of bytes of samples that have been read, but not yet written */
+static size_t _max_in_flight = 64 * 1024 * 1024;
+
+/** Level in dBFS below which leading and trailing audio is trimmed when encoding, if at all */
+static std::optional<double> _trim_silence;
+
+/** Alignment in bytes of the sample data in encoded cat files; 0 means no alignment */
+static uint32_t _align = 0;
+
+
+/** Comment in a sfo file with the amount of padding after the name of the sample on the next line */
+static const char SFO_NAME_PADDING[] = "// name padding ";
+
+/** Function to open a file mentioned in a sfo file for reading */
+using OpenReader = std::function<std::unique_ptr<Reader>(const std::string &filename)>;
+
+/** Function to open a file mentioned in a sfo file for writing */
+using OpenWriter = std::function<std::unique_ptr<Writer>(const std::string &filename)>;
+
+/** Files that are kept in memory instead of on disk, by their filename */
+using MemoryFiles = std::map<std::string, std::vector<uint8_t>>;
+
+/** Samples that are already loaded, by their filename */
+using LoadedSamples = std::unordered_multimap<std::string, Sample>;
+
+/**
+ * Open a file on disk for reading.
+ * @param filename the file to open
+ * @return the reader for the file
+ */
+static std::unique_ptr<Reader> OpenFileReader(const std::string &filename)
 {
-	if (!_interactive) return;
+	/* Samples are read once, completely, so there is no use in caching them. */
+	return std::make_unique<FileReader>(filename, true, AccessHint::Sequential);
+}
 
-	printf(".");
-	fflush(stdin);
+/**
+ * Open a file on disk for writing.
+ * @param filename the file to open
+ * @return the writer for the file
+ */
+static std::unique_ptr<Writer> OpenFileWriter(const std::string &filename)
+{
+	return std::make_unique<FileWriter>(filename);
 }
 
+/**
+ * Read a cat entry, in the format of the cat file, from a reader.
+ * @param sample     the sample of the cat entry; its offset and size must be known
+ * @param reader     reader for the file, at the offset of the cat entry
+ * @param new_format whether the cat file is in the new format
+ * @param index      index of sample in cat header
+ */
+static void ReadCatEntry(Sample &sample, Reader &reader, bool new_format, uint32_t index)
+{
+	if (new_format) {
+		sample.ReadCatEntry<true>(reader, index);
+	} else {
+		sample.ReadCatEntry<false>(reader, index);
+	}
+}
 
 /**
- * Read a cat file from a reader and extract it's samples.
- * @param samples collection to put our samples in
- * @param reader  reader for the file
+ * Read a cat file from a reader and extract it's samples. Every sample
+ * is handed over as soon as it has been read. When the reader can be read
+ * concurrently, the samples are read in batches of at most window bytes,
+ * of which the samples are read in parallel, each from their own cursor.
+ * The header table is checked against the size of the file before any
+ * sample is handed over.
+ * @param reader   reader for the file
+ * @param consume  function to take over each read sample; returns false to stop reading
+ * @param progress progress to tell the amount of work to, if any
+ * @param window   maximum amount of bytes of samples to read in parallel
  */
-static void ReadCat(Samples &samples, FileReader &reader)
+static void ReadCat(Reader &reader, const std::function<bool(Sample &&)> &consume, Progress *progress = nullptr, size_t window = SIZE_MAX)
 {
-	uint32_t count = reader.ReadDword();
-	bool new_format = (count >> 31) != 0;
-	count &= 0x7FFFFFFFU;
-	count /= 8;
+	uint8_t buffer[CatHeaderEntry::Layout::size];
+	reader.ReadRaw(buffer, sizeof(buffer));
 
+	uint32_t count = CatHeaderEntry::Offset::Unpack(buffer);
+	bool new_format = (count & CatHeaderEntry::NEW_FORMAT) != 0;
+	count &= CatHeaderEntry::OFFSET_MASK;
+	count /= CatHeaderEntry::Layout::size;
+
+	Samples samples;
+	uint64_t total = 0;
 	reader.Seek(0);
 	for (uint32_t i = 0; i < count; i++) {
 		samples.emplace_back(reader);
+		total += samples.back().GetSize();
 	}
 
-	uint32_t index = 0;
-	for (auto iter = samples.begin(); iter != samples.end(); ++iter, ++index) {
-		iter->ReadCatEntry(reader, new_format, index);
-		ShowProgress();
+	/* Samples are handed over while reading, so check what can be checked before handing over any. */
+	uint64_t end = reader.GetPos();
+	for (const Sample &sample : samples) {
+		if (sample.GetOffset() < end) throw "Invalid offset in file " + reader.GetFilename();
+		end = (uint64_t)sample.GetOffset() + sample.GetSize();
+		if (end > reader.GetSize()) throw "Unexpected end of " + reader.GetFilename();
+	}
+	if (progress != nullptr) progress->SetTotal(count, total);
+
+	if (GetThreadCount() == 1 || reader.OpenCursor() == nullptr) {
+		uint32_t index = 0;
+		for (auto iter = samples.begin(); iter != samples.end(); ++iter, ++index) {
+			ReadCatEntry(*iter, reader, new_format, index);
+			if (!consume(std::move(*iter))) return;
+		}
+		return;
+	}
+
+	if (!samples.empty() && reader.GetPos() != samples[0].GetOffset()) throw "Invalid offset in file " + reader.GetFilename();
+
+	for (size_t begin = 0; begin < samples.size(); ) {
+		size_t end = begin;
+		uint64_t size = 0;
+		do {
+			size += samples[end].GetSize();
+			end++;
+		} while (end < samples.size() && size + samples[end].GetSize() <= window);
+
+		std::vector<uint64_t> entry_ends(end - begin);
+		ParallelRead(reader, end - begin, [&](Reader &entry_reader, size_t index) {
+			Sample &sample = samples[begin + index];
+			entry_reader.Seek(sample.GetOffset());
+			ReadCatEntry(sample, entry_reader, new_format, (uint32_t)(begin + index));
+			entry_ends[index] = entry_reader.GetPos();
+		});
+
+		for (size_t index = begin; index < end; index++) {
+			/* Like reading them one after another, entries must follow each other. */
+			if (index + 1 < samples.size() && entry_ends[index - begin] != samples[index + 1].GetOffset()) {
+				throw "Invalid offset in file " + reader.GetFilename();
+			}
+			if (!consume(std::move(samples[index]))) return;
+		}
+
+		/* Windows are read in order, so nothing before the end of this one is read again. */
+		reader.ReleaseBefore(entry_ends.back());
+		begin = end;
 	}
 }
 
 /**
- * Write a cat file (including the samples) to a cat file
+ * Pad a sample, so the sample data of the sample after it starts at a
+ * multiple of _align. The sample data of the first sample can only be
+ * aligned by padding its name, which is limited in size.
+ * @param samples the samples that are being written
+ * @param index   the index of the sample to pad; its offset must be set
+ */
+static void AlignSample(Samples &samples, size_t index)
+{
+	Sample &sample = samples[index];
+
+	/* Any existing padding is only in the way of the new alignment. */
+	sample.SetNamePadding(0);
+	sample.SetPadding(0);
+
+	if (index == 0) {
+		uint32_t needed = (_align - sample.GetDataOffset() % _align) % _align;
+		if (!sample.SetNamePadding(needed)) {
+			ShowWarning("the data of %s can not be aligned, as its name would become too long", sample.GetName().c_str());
+		}
+	}
+
+	if (index + 1 == samples.size()) return;
+
+	/* Only the first sample gets its name padded, but the next sample may have been first before. */
+	Sample &next = samples[index + 1];
+	next.SetNamePadding(0);
+	uint32_t needed = (_align - (sample.GetNextOffset() + next.GetHeadSize()) % _align) % _align;
+	if (!sample.SetPadding(needed)) {
+		ShowWarning("the data of %s can not be aligned, as %s is a raw sample that can not be padded", next.GetName().c_str(), sample.GetName().c_str());
+	}
+}
+
+/**
+ * Write a cat file (including the samples) to a cat file. The header table
+ * is written first, after which the entries are written in parallel.
  * @param samples collection samples to write to the cat file
  * @param writer writer for the file
  */
-static void WriteCat(Samples &samples, FileWriter &writer)
+static void WriteCat(Samples &samples, Writer &writer)
 {
-	uint32_t offset = (uint32_t)samples.size() * 8;
-	for (auto iter = samples.begin(); iter != samples.end(); ++iter) {
-		Sample &sample = *iter;
+	Progress progress(_interactive);
+	uint64_t total = 0;
+
+	uint64_t offset = samples.size() * CatHeaderEntry::Layout::size;
+	for (size_t index = 0; index < samples.size(); index++) {
+		Sample &sample = samples[index];
 
 		sample.SetOffset(offset);
+		if (_align != 0) AlignSample(samples, index);
 		offset = sample.GetNextOffset();
+		total += sample.GetSize();
 
-		writer.WriteDword(sample.GetOffset() | (1U << 31));
-		writer.WriteDword(sample.GetSize());
+		uint8_t buffer[CatHeaderEntry::Layout::size];
+		CatHeaderEntry::Offset::Pack(buffer, sample.GetOffset() | CatHeaderEntry::NEW_FORMAT);
+		CatHeaderEntry::Size::Pack(buffer, sample.GetSize());
+		writer.WriteRaw(buffer, sizeof(buffer));
 	}
 
-	for (auto iter = samples.begin(); iter != samples.end(); ++iter) {
-		iter->WriteCatEntry(writer);
-		ShowProgress();
-	}
+	/* All offsets are known, so the entries can be written at the same time. */
+	progress.SetTotal(samples.size(), total);
+	writer.Preallocate(offset);
+	ParallelFor(samples.size(), [&](unsigned int, size_t index) {
+		samples[index].WriteCatEntryAt(writer);
+		progress.Done(samples[index].GetSize());
+	});
 }
 
 
@@ -91,8 +259,10 @@ static void WriteCat(Samples &samples, FileWriter &writer)
  * Read a sfo file from a reader and and the samples mentioned in there
  * @param samples collection to put our samples in
  * @param reader  reader for the sfo file
+ * @param reuse   samples that are already loaded and still up to date, by their filename, if any
+ * @param open    function to open the files of the samples
  */
-static void ReadSFO(Samples &samples, FileReader &reader)
+static void ReadSFO(Samples &samples, Reader &reader, LoadedSamples *reuse = nullptr, const OpenReader &open = OpenFileReader)
 {
 	/* Temporary read buffer; 512 is long enough for all valid
 	 * lines because the filename and name may be at most 255.
@@ -100,8 +270,18 @@ static void ReadSFO(Samples &samples, FileReader &reader)
 	 * got exactly 512. */
 	char buffer[512] = "";
 	char *filename;
+	unsigned int name_padding = 0;
+
+	/* The number of samples is not known until the whole file is read. */
+	Progress progress(_interactive);
 
 	while (reader.ReadLine(buffer, sizeof(buffer)) != NULL) {
+		/* The padding of the name of the next sample hides in a comment. */
+		if (strncmp(buffer, SFO_NAME_PADDING, strlen(SFO_NAME_PADDING)) == 0) {
+			name_padding = (unsigned int)strtoul(buffer + strlen(SFO_NAME_PADDING), nullptr, 10);
+			continue;
+		}
+
 		/* Line with comment */
 		if (strncmp(buffer, "//", 2) == 0) continue;
 
@@ -130,34 +310,527 @@ static void ReadSFO(Samples &samples, FileReader &reader)
 		if (strlen(filename) + 1 > 255) throw "Filename is too long in " + reader.GetFilename() + " at [" + buffer + "]";
 		if (strlen(name)     + 1 > 255) throw "Name is too long in " + reader.GetFilename() + " at [" + name + "]";
 
-		samples.emplace_back(filename, name);
+		bool reused = false;
+		if (reuse != nullptr) {
+			/* The same file may be used for multiple samples, under different names. */
+			auto range = reuse->equal_range(filename);
+			auto loaded = std::find_if(range.first, range.second, [&](const LoadedSamples::value_type &entry) {
+				return entry.second.GetName() == name;
+			});
+			if (loaded != range.second) {
+				samples.emplace_back(std::move(loaded->second));
+				reuse->erase(loaded);
+				reused = true;
+			}
+		}
+		if (!reused) {
+			std::unique_ptr<Reader> sample_reader = open(filename);
+			samples.emplace_back(*sample_reader, name, filename);
+		}
+
+		if (!samples.back().SetNamePadding(name_padding)) throw "Name padding is too long in " + reader.GetFilename() + " at [" + name + "]";
+		name_padding = 0;
 
-		ShowProgress();
+		progress.Done(samples.back().GetSize());
 	}
 }
 
 /**
  * Write a sfo file and the samples to disk
- * @param samples collection samples to write to the sfo file and disk
- * @param writer writer for the sfo file
+ * @param queue    queue to take the samples to write to the sfo file and disk from
+ * @param writer   writer for the sfo file
+ * @param progress progress to mark the written samples as done in
+ * @param open     function to open the files of the samples
  */
-static void WriteSFO(Samples &samples, FileWriter &writer)
+static void WriteSFO(BoundedQueue<Sample> &queue, Writer &writer, Progress &progress, const OpenWriter &open)
 {
 	writer.WriteString("// \"file name\" internal name\n");
 
-	for (auto iter = samples.begin(); iter != samples.end(); ++iter) {
-		Sample &sample = *iter;
+	while (std::optional<Sample> sample = queue.Pop()) {
+		/* As a comment, so older versions can still read the sfo file. */
+		if (sample->GetNamePadding() != 0) writer.WriteString("%s%u\n", SFO_NAME_PADDING, sample->GetNamePadding());
+		writer.WriteString("\"%s\" %s\n", sample->GetFilename().c_str(), sample->GetName().c_str());
+
+		std::unique_ptr<Writer> sample_writer = open(sample->GetFilename());
+		sample->WriteSample(*sample_writer);
+		sample_writer->Close();
+
+		queue.Release(sample->GetSize());
+		progress.Done(sample->GetSize());
+	}
+}
+
+
+/**
+ * Get the sfo file that belongs to a cat file.
+ * @param cat_file the cat file
+ * @return the name of the sfo file
+ */
+static std::string GetSFOFilename(const std::string &cat_file)
+{
+	size_t ext = cat_file.rfind('.');
+	if (ext == std::string::npos || cat_file.compare(ext, std::string::npos, ".cat") != 0) {
+		throw std::string("Unexpected extension; expected \".cat\"");
+	}
+	return cat_file.substr(0, ext) + ".sfo";
+}
+
+/**
+ * Decode a cat, so read the cat and then write the sfo and the samples.
+ * Reading the cat and writing the samples happen at the same time, with
+ * at most _max_in_flight bytes of samples read but not written yet; half
+ * of it for the samples that are being read in parallel and half of it for
+ * the samples that are waiting to be written.
+ * @param reader     reader for the cat
+ * @param sfo_writer writer for the sfo
+ * @param open       function to open the files of the samples
+ */
+static void Decode(Reader &reader, Writer &sfo_writer, const OpenWriter &open)
+{
+	Progress progress(_interactive);
+	size_t window = _max_in_flight / 2;
+	BoundedQueue<Sample> queue(_max_in_flight - window);
+	std::exception_ptr error;
+	std::thread producer([&]() {
+		try {
+			ReadCat(reader, [&](Sample &&sample) {
+				size_t size = sample.GetSize();
+				return queue.Push(std::move(sample), size);
+			}, &progress, window);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		queue.Close();
+	});
+
+	try {
+		WriteSFO(queue, sfo_writer, progress, open);
+	} catch (...) {
+		queue.Abort();
+		producer.join();
+		throw;
+	}
+	producer.join();
+	progress.Finish();
+	if (error) std::rethrow_exception(error);
+}
+
+/**
+ * Decode the file, so read the cat and then write the sfo.
+ * @param cat_file the cat file to decode
+ */
+static void Decode(const std::string &cat_file)
+{
+	std::string sfo_file = GetSFOFilename(cat_file);
+
+	if (_interactive) printf("Reading %s\n", cat_file.c_str());
+	std::unique_ptr<Reader> cat_reader = OpenCatReader(cat_file);
+	Reader &reader = *cat_reader;
+
+	if (_interactive) printf("Writing %s\n", sfo_file.c_str());
+	FileWriter sfo_writer(sfo_file, false);
+
+	Decode(reader, sfo_writer, OpenFileWriter);
+
+	sfo_writer.Close();
+}
+
+/**
+ * Trim the silence from the samples, if requested, and report the savings.
+ * @param samples the samples to trim
+ */
+static void TrimSilence(Samples &samples)
+{
+	if (!_trim_silence.has_value()) return;
+
+	std::vector<uint32_t> removed(samples.size());
+	ParallelFor(samples.size(), [&](unsigned int, size_t index) {
+		removed[index] = samples[index].TrimSilence(*_trim_silence);
+	});
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < samples.size(); i++) {
+		if (removed[i] == 0) continue;
+		printf("Trimmed %u bytes of silence from %s\n", removed[i], samples[i].GetName().c_str());
+		total += removed[i];
+	}
+	if (total != 0) printf("Trimmed %llu bytes of silence in total\n", (unsigned long long)total);
+}
+
+/**
+ * Encode the file, so read the sfo and then write the cat.
+ * @param cat_file the cat file to encode
+ */
+static void Encode(const std::string &cat_file)
+{
+	Samples samples;
+	std::string sfo_file = GetSFOFilename(cat_file);
+
+	if (_interactive) printf("Reading %s\n", sfo_file.c_str());
+	FileReader sfo_reader(sfo_file, false);
+	ReadSFO(samples, sfo_reader);
+	TrimSilence(samples);
+
+	if (_interactive) printf("Writing %s\n", cat_file.c_str());
+	FileWriter cat_writer(cat_file);
+	WriteCat(samples, cat_writer);
+	cat_writer.Close();
+}
+
+/**
+ * Encode the file, and keep encoding it whenever the sfo or any of the
+ * samples change. The samples are kept in memory, so only the changed
+ * samples have to be loaded again.
+ * @param cat_file the cat file to encode
+ */
+static void Watch(const std::string &cat_file)
+{
+	Samples samples;
+	std::string sfo_file = GetSFOFilename(cat_file);
+	FileWatcher watcher;
+
+	std::set<std::string> changed = { sfo_file };
+	for (;;) {
+		try {
+			/* Throw away the samples that changed, and reload them. */
+			LoadedSamples reuse;
+			for (Sample &sample : samples) {
+				if (changed.count(sample.GetFilename()) == 0) reuse.emplace(sample.GetFilename(), std::move(sample));
+			}
+			samples.clear();
+
+			if (_interactive) printf("Reading %s\n", sfo_file.c_str());
+			watcher.Watch(sfo_file);
+			FileReader sfo_reader(sfo_file, false);
+			ReadSFO(samples, sfo_reader, &reuse, [&](const std::string &filename) {
+				/* Watch before loading, so fixing a sample that fails to load is noticed too. */
+				watcher.Watch(filename);
+				return OpenFileReader(filename);
+			});
+			TrimSilence(samples);
+
+			if (_interactive) printf("Writing %s\n", cat_file.c_str());
+			FileWriter cat_writer(cat_file);
+			WriteCat(samples, cat_writer);
+			cat_writer.Close();
+			if (_interactive) printf("Waiting for changes\n");
+		} catch (const std::string &s) {
+			/* Keep the samples that did load, and wait for the user to fix the problem. */
+			fprintf(stderr, "An error occured: %s\n", s.c_str());
+		}
+
+		changed = watcher.WaitForChanges();
+	}
+}
+
+/**
+ * Get a string as JSON string, including the quotes.
+ * Names in cat files are not UTF-8, so every byte that is not printable ASCII is
+ * escaped as the code point with the same value to keep the JSON valid.
+ * @param str the string
+ * @return the JSON string
+ */
+static std::string ToJSON(const std::string &str)
+{
+	std::string json = "\"";
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			json += '\\';
+			json += c;
+		} else if ((unsigned char)c < 0x20 || (unsigned char)c >= 0x7F) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+			json += escaped;
+		} else {
+			json += c;
+		}
+	}
+	return json + "\"";
+}
 
-		writer.WriteString("\"%s\" %s\n", sample.GetFilename().c_str(), sample.GetName().c_str());
+/**
+ * Get a level relative to full scale in dBFS as JSON number.
+ * @param level the level
+ * @return the JSON number, or null for silence
+ */
+static std::string ToDecibelJSON(double level)
+{
+	if (level <= 0) return "null";
 
-		FileWriter sample_writer(sample.GetFilename());
-		sample.WriteSample(sample_writer);
-		sample_writer.Close();
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.2f", 20 * std::log10(level));
+	return buffer;
+}
 
-		ShowProgress();
+/**
+ * Analyze the audio of all samples in a cat file, and write a report in
+ * JSON to the standard output.
+ * @param cat_file the cat file to analyze
+ */
+static void Analyze(const std::string &cat_file)
+{
+	Samples samples;
+	std::unique_ptr<Reader> cat_reader = OpenCatReader(cat_file);
+	Reader &reader = *cat_reader;
+	ReadCat(reader, [&](Sample &&sample) {
+		samples.emplace_back(std::move(sample));
+		return true;
+	});
+
+	std::vector<AudioStats> stats(samples.size());
+	ParallelFor(samples.size(), [&](unsigned int, size_t index) {
+		const Sample &sample = samples[index];
+		stats[index] = AnalyzeAudio(sample.GetSampleData().data(), sample.GetSampleData().size(), sample.GetBitsPerSample(), DEFAULT_SILENCE_THRESHOLD);
+	});
+
+	printf("[\n");
+	for (size_t i = 0; i < samples.size(); i++) {
+		const Sample &sample = samples[i];
+		const AudioStats &stat = stats[i];
+
+		printf("\t{\n");
+		printf("\t\t\"name\": %s,\n", ToJSON(sample.GetName()).c_str());
+		printf("\t\t\"filename\": %s,\n", ToJSON(sample.GetFilename()).c_str());
+		printf("\t\t\"sample_rate\": %u,\n", sample.GetSampleRate());
+		printf("\t\t\"bits_per_sample\": %u,\n", sample.GetNumChannels() == 0 ? 8 : sample.GetBitsPerSample());
+		printf("\t\t\"raw\": %s,\n", sample.GetNumChannels() == 0 ? "true" : "false");
+		printf("\t\t\"frames\": %llu,\n", (unsigned long long)stat.frames);
+		printf("\t\t\"peak\": %.6f,\n", stat.peak);
+		printf("\t\t\"peak_dbfs\": %s,\n", ToDecibelJSON(stat.peak).c_str());
+		printf("\t\t\"rms\": %.6f,\n", stat.rms);
+		printf("\t\t\"rms_dbfs\": %s,\n", ToDecibelJSON(stat.rms).c_str());
+		printf("\t\t\"dc_offset\": %.6f,\n", stat.dc_offset);
+		printf("\t\t\"clipped\": %llu,\n", (unsigned long long)stat.clipped);
+		printf("\t\t\"silence_ratio\": %.6f\n", stat.silence_ratio);
+		printf("\t}%s\n", i + 1 == samples.size() ? "" : ",");
 	}
+	printf("]\n");
 }
 
+/** The ways to edit a cat file in place. */
+enum class EditOperation {
+	Add,     ///< Add a new sample
+	Replace, ///< Replace an existing sample
+	Remove,  ///< Remove an existing sample
+};
+
+/**
+ * Edit a single sample of a cat file without decoding it. The entries
+ * that are not touched are copied verbatim.
+ * @param cat_file the cat file to edit
+ * @param op       the edit to perform
+ * @param name     the name of the sample to edit
+ * @param filename the file to read the sample from, if any
+ */
+static void Edit(const std::string &cat_file, EditOperation op, const std::string &name, const std::string &filename = {})
+{
+	if (name.length() + 1 > 255) throw "Name is too long [" + name + "]";
+	if (filename.length() + 1 > 255) throw "Filename is too long [" + filename + "]";
+
+	FileWriter cat_writer(cat_file);
+	{
+		if (_interactive) printf("Reading %s\n", cat_file.c_str());
+		std::unique_ptr<Reader> cat_reader = OpenCatReader(cat_file);
+		Reader &reader = *cat_reader;
+		Catalogue catalogue(reader);
+		if (!catalogue.IsNewFormat()) throw "Editing old format cat files is not supported; upgrade " + cat_file + " first";
+
+		/* Sounds are known by their index, so every entry is kept, even when names are used multiple times. */
+		CatBuilder builder;
+		size_t matches = 0;
+		for (const CatEntry &entry : catalogue.GetEntries()) {
+			builder.Append(catalogue, entry);
+			if (entry.name == name) matches++;
+		}
+		if (op != EditOperation::Add && matches > 1) throw "Sample " + name + " exists multiple times in " + cat_file + "; it is not clear which one to edit";
+
+		switch (op) {
+			case EditOperation::Add: {
+				if (builder.Contains(name)) throw "Sample " + name + " already exists in " + cat_file;
+				FileReader sample_reader(filename, true, AccessHint::Sequential);
+				builder.Put(Sample(sample_reader, name, filename));
+				break;
+			}
+
+			case EditOperation::Replace: {
+				if (!builder.Contains(name)) throw "Sample " + name + " does not exist in " + cat_file;
+				FileReader sample_reader(filename, true, AccessHint::Sequential);
+				builder.Put(Sample(sample_reader, name, filename));
+				break;
+			}
+
+			case EditOperation::Remove:
+				if (!builder.Remove(name)) throw "Sample " + name + " does not exist in " + cat_file;
+				break;
+		}
+
+		if (_interactive) printf("Writing %s\n", cat_file.c_str());
+		builder.Write(cat_writer);
+	}
+	cat_writer.Close();
+}
+
+/**
+ * Convert a cat file in the old format into one in the new format in a
+ * single pass, without decoding the samples to disk.
+ * @param old_file the cat file in the old format
+ * @param new_file the cat file to write in the new format
+ */
+static void Upgrade(const std::string &old_file, const std::string &new_file)
+{
+	FileWriter cat_writer(new_file);
+	{
+		if (_interactive) printf("Reading %s\n", old_file.c_str());
+		std::unique_ptr<Reader> cat_reader = OpenCatReader(old_file);
+		Reader &reader = *cat_reader;
+		Catalogue catalogue(reader);
+		if (catalogue.IsNewFormat()) throw old_file + " is already in the new format";
+
+		/* Sounds are known by their index, so every entry is kept, even when names are used multiple times. */
+		CatBuilder builder;
+		for (const CatEntry &entry : catalogue.GetEntries()) {
+			builder.Append(catalogue, entry);
+		}
+
+		if (_interactive) printf("Writing %s\n", new_file.c_str());
+		builder.Write(cat_writer);
+	}
+	cat_writer.Close();
+}
+
+
+/**
+ * Merge cat files and sfo files into a new cat file. Later sources win
+ * from earlier ones for samples with the same name; the replaced sample
+ * keeps its position. Entries of cat files are copied without decoding
+ * them, upgrading them when they are in the old format.
+ * @param sources  the cat and sfo files to merge, in order
+ * @param out_file the cat file to write
+ */
+static void Merge(const std::vector<std::string> &sources, const std::string &out_file)
+{
+	std::vector<std::unique_ptr<Reader>> readers;
+	std::vector<std::unique_ptr<Catalogue>> catalogues;
+	CatBuilder builder;
+
+	for (const std::string &source : sources) {
+		if (_interactive) printf("Reading %s\n", source.c_str());
+
+		size_t ext = source.rfind('.');
+		std::string extension = ext == std::string::npos ? std::string() : source.substr(ext);
+		if (extension == ".cat") {
+			readers.emplace_back(OpenCatReader(source));
+			catalogues.emplace_back(std::make_unique<Catalogue>(*readers.back()));
+			for (const CatEntry &entry : catalogues.back()->GetEntries()) {
+				builder.Put(*catalogues.back(), entry);
+			}
+		} else if (extension == ".sfo") {
+			/* The samples are next to the sfo file, wherever that is. */
+			size_t separator = source.rfind('/');
+			std::string directory = separator == std::string::npos ? std::string() : source.substr(0, separator + 1);
+
+			Samples samples;
+			FileReader sfo_reader(source, false);
+			ReadSFO(samples, sfo_reader, nullptr, [&](const std::string &filename) {
+				return OpenFileReader(filename[0] == '/' ? filename : directory + filename);
+			});
+			TrimSilence(samples);
+			for (Sample &sample : samples) {
+				builder.Put(std::move(sample));
+			}
+		} else {
+			throw "Unexpected extension; expected \".cat\" or \".sfo\" for " + source;
+		}
+	}
+
+	if (_interactive) printf("Writing %s\n", out_file.c_str());
+	FileWriter cat_writer(out_file);
+	builder.Write(cat_writer);
+	cat_writer.Close();
+}
+
+/**
+ * Decode a cat file and encode it again, completely in memory, and check
+ * whether that results in exactly the same cat file. Nothing is written
+ * to disk.
+ * @param cat_file the cat file to check
+ * @return true if the encoded cat file is the same as the original
+ */
+static bool RoundtripCheck(const std::string &cat_file)
+{
+	std::string sfo_file = GetSFOFilename(cat_file);
+	MemoryFiles files;
+
+	if (_interactive) printf("Decoding %s in memory\n", cat_file.c_str());
+	MappedReader reader(cat_file, AccessHint::Sequential);
+	{
+		MemoryWriter sfo_writer(files[sfo_file], sfo_file);
+		Decode(reader, sfo_writer, [&](const std::string &filename) {
+			return std::make_unique<MemoryWriter>(files[filename], filename);
+		});
+		sfo_writer.Close();
+	}
+
+	if (_interactive) printf("Encoding %s in memory\n", cat_file.c_str());
+	Samples samples;
+	MemoryReader sfo_reader(files[sfo_file].data(), files[sfo_file].size(), sfo_file);
+	ReadSFO(samples, sfo_reader, nullptr, [&](const std::string &filename) -> std::unique_ptr<Reader> {
+		auto file = files.find(filename);
+		if (file == files.end()) throw "Could not open " + filename + " for reading";
+		return std::make_unique<MemoryReader>(file->second.data(), file->second.size(), filename);
+	});
+
+	std::vector<uint8_t> encoded;
+	MemoryWriter cat_writer(encoded, cat_file);
+	WriteCat(samples, cat_writer);
+	cat_writer.Close();
+
+	const uint8_t *original = reader.GetData();
+	size_t original_size = (size_t)reader.GetSize();
+	size_t common = std::min(original_size, encoded.size());
+	size_t mismatch = std::mismatch(original, original + common, encoded.data()).first - original;
+	if (mismatch == common && original_size == encoded.size()) {
+		printf("%s is the same after decoding and encoding it\n", cat_file.c_str());
+		return true;
+	}
+
+	printf("%s differs from offset %zu after decoding and encoding it\n", cat_file.c_str(), mismatch);
+	return false;
+}
+
+
+/**
+ * Parse the numeric value of an option.
+ * @param option the option the value belongs to
+ * @param value  the value to parse
+ * @return the parsed value
+ */
+static unsigned long ParseNumber(const char *option, const char *value)
+{
+	char *end;
+	errno = 0;
+	unsigned long number = strtoul(value, &end, 10);
+	if (errno != 0 || end == value || *end != '\0' || *value == '-') {
+		throw std::string("Invalid value for ") + option + " [" + value + "]";
+	}
+	return number;
+}
+
+/**
+ * Parse a level in dBFS given as value of an option.
+ * @param option the option the value belongs to
+ * @param value  the value to parse
+ * @return the parsed level
+ */
+static double ParseDecibels(const char *option, const char *value)
+{
+	char *end;
+	double level = strtod(value, &end);
+	if (end == value || *end != '\0' || !(level <= 0)) {
+		throw std::string("Invalid value for ") + option + "; expected a level in dBFS of at most 0 [" + value + "]";
+	}
+	return level;
+}
 
 /**
  * Show the help to the user.
@@ -172,13 +845,54 @@ void ShowHelp(const char *cmd)
 		"    Decode all samples in the sample file and put them in this directory\n"
 		"  %s -e <sample file>\n"
 		"    Encode all samples in this directory and put them in the sample file\n"
+		"  %s --watch <sample file>\n"
+		"    Encode like -e, and encode again whenever any of the samples change\n"
+		"  %s --add <name> <wav file> <sample file>\n"
+		"    Add the sample in the wav file to the sample file\n"
+		"  %s --replace <name> <wav file> <sample file>\n"
+		"    Replace the named sample in the sample file with the wav file\n"
+		"  %s --remove <name> <sample file>\n"
+		"    Remove the named sample from the sample file\n"
+		"  %s --upgrade <old sample file> <new sample file>\n"
+		"    Convert a sample file in the original format into the new format\n"
+		"  %s --merge <sample or sfo file>... -o <sample file>\n"
+		"    Merge sample files and sfo files into a new sample file; samples in\n"
+		"    later files replace samples with the same name in earlier files\n"
+		"  %s --roundtrip-check <sample file>\n"
+		"    Check that decoding and encoding the sample file, in memory, gives the same file\n"
+		"  %s --diff <old sample file> <new sample file>\n"
+		"    Show the differences between the samples in both sample files\n"
+		"  %s --make-patch <old sample file> <new sample file> -o <patch file>\n"
+		"    Make a patch with only the samples of the new sample file that are not\n"
+		"    in the old sample file\n"
+		"  %s --apply-patch <old sample file> <patch file> -o <new sample file>\n"
+		"    Apply a patch made with --make-patch to the old sample file\n"
+		"  %s --analyze <sample file>\n"
+		"    Report peak, RMS, DC offset, clipping and silence of all samples in JSON\n"
+		"  %s --waveforms <sample file> -o <waveform file>\n"
+		"    Update the waveform overviews of all samples in the waveform file\n"
 		"\n"
 		"<sample file> denotes the .cat file you want to work on, e.g. sample.cat\n"
 		"\n"
+		"Options:\n"
+		"  --align <bytes>\n"
+		"    Pad the samples when encoding, so their data starts at a multiple of\n"
+		"    the given power of two\n"
+		"  --direct\n"
+		"    Read sample files without going through the cache of the operating system\n"
+		"  --max-inflight <MiB>\n"
+		"    Maximum amount of sample data read but not yet written while decoding;\n"
+		"    defaults to 64 MiB\n"
+		"  --trim-silence <dBFS>\n"
+		"    Remove leading and trailing audio below the given level when encoding\n"
+		"  --threads <count>\n"
+		"    Number of threads to use for work that can be done in parallel;\n"
+		"    defaults to one per core\n"
+		"\n"
 		"catcodec is Copyright 2009 by Remko Bijker\n"
 		"You may copy and redistribute it under the terms of the GNU General Public\n"
 		"License version 2, as stated in the file 'COPYING'\n",
-		_catcodec_version, cmd, cmd
+		_catcodec_version, cmd, cmd, cmd, cmd, cmd, cmd, cmd, cmd, cmd, cmd, cmd, cmd, cmd, cmd
 	);
 }
 
@@ -190,49 +904,77 @@ void ShowHelp(const char *cmd)
 int main(int argc, char *argv[])
 {
 	int ret = 0;
-	Samples samples;
 	_interactive = isatty(fileno(stdout)) == 1;
 
 	try {
-		if (argc != 3 || (strcmp(argv[1], "-d") != 0 && strcmp(argv[1], "-e") != 0)) {
-			ShowHelp(argv[0]);
-			return 0;
+		/* Split the options from the actual command. */
+		std::vector<std::string> args;
+		for (int i = 1; i < argc; i++) {
+			if (strcmp(argv[i], "--max-inflight") == 0 && i + 1 < argc) {
+				_max_in_flight = ParseNumber(argv[i], argv[i + 1]) * 1024 * 1024;
+				i++;
+				continue;
+			}
+			if (strcmp(argv[i], "--trim-silence") == 0 && i + 1 < argc) {
+				_trim_silence = ParseDecibels(argv[i], argv[i + 1]);
+				i++;
+				continue;
+			}
+			if (strcmp(argv[i], "--align") == 0 && i + 1 < argc) {
+				unsigned long align = ParseNumber(argv[i], argv[i + 1]);
+				if (align == 0 || (align & (align - 1)) != 0 || align > CatHeaderEntry::OFFSET_MASK) {
+					throw std::string("Invalid value for ") + argv[i] + "; expected a power of two [" + argv[i + 1] + "]";
+				}
+				_align = (uint32_t)align;
+				i++;
+				continue;
+			}
+			if (strcmp(argv[i], "--direct") == 0) {
+				_direct = true;
+				continue;
+			}
+			if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+				_threads = ParseNumber(argv[i], argv[i + 1]);
+				i++;
+				continue;
+			}
+			args.emplace_back(argv[i]);
 		}
 
-		char sfo_file[1024];
-		strncpy(sfo_file, argv[2], sizeof(sfo_file));
-		char *ext = strrchr(sfo_file, '.');
-		if (ext == NULL || strlen(ext) != 4 || strcmp(ext, ".cat") != 0) {
-			throw std::string("Unexpected extension; expected \".cat\"");
-		}
-		strcpy(ext, ".sfo");
-
-		if (strcmp(argv[1], "-d") == 0) {
-			/* Decode the file, so read the cat and then write the sfo */
-
-			if (_interactive) printf("Reading %s\n", argv[2]);
-			FileReader reader(argv[2]);
-			ReadCat(samples, reader);
-
-			if (_interactive) printf("\nWriting %s\n", sfo_file);
-			FileWriter sfo_writer(sfo_file, false);
-			WriteSFO(samples, sfo_writer);
-			sfo_writer.Close();
-		} else if (strcmp(argv[1], "-e") == 0) {
-			/* Encode the file, so read the sfo and then write the cat */
-
-			if (_interactive) printf("Reading %s\n", sfo_file);
-			FileReader sfo_reader(sfo_file, false);
-			ReadSFO(samples, sfo_reader);
-
-			if (_interactive) printf("\nWriting %s\n", argv[2]);
-			FileWriter cat_writer(argv[2]);
-			WriteCat(samples, cat_writer);
-			cat_writer.Close();
+		if (args.size() == 2 && args[0] == "-d") {
+			Decode(args[1]);
+		} else if (args.size() == 2 && args[0] == "-e") {
+			Encode(args[1]);
+		} else if (args.size() == 2 && args[0] == "--watch") {
+			Watch(args[1]);
+		} else if (args.size() == 4 && args[0] == "--add") {
+			Edit(args[3], EditOperation::Add, args[1], args[2]);
+		} else if (args.size() == 4 && args[0] == "--replace") {
+			Edit(args[3], EditOperation::Replace, args[1], args[2]);
+		} else if (args.size() == 3 && args[0] == "--remove") {
+			Edit(args[2], EditOperation::Remove, args[1]);
+		} else if (args.size() == 3 && args[0] == "--upgrade") {
+			Upgrade(args[1], args[2]);
+		} else if (args.size() == 2 && args[0] == "--analyze") {
+			/* The report is all there should be on the output. */
+			Analyze(args[1]);
+			return 0;
+		} else if (args.size() >= 4 && args[0] == "--merge" && args[args.size() - 2] == "-o") {
+			Merge(std::vector<std::string>(args.begin() + 1, args.end() - 2), args.back());
+		} else if (args.size() == 2 && args[0] == "--roundtrip-check") {
+			return RoundtripCheck(args[1]) ? 0 : 1;
+		} else if (args.size() == 3 && args[0] == "--diff") {
+			/* Like diff, tell scripts whether there are differences. */
+			return DiffCat(args[1], args[2]) ? 0 : 1;
+		} else if (args.size() == 5 && args[0] == "--make-patch" && args[3] == "-o") {
+			MakePatch(args[1], args[2], args[4]);
+		} else if (args.size() == 5 && args[0] == "--apply-patch" && args[3] == "-o") {
+			ApplyPatch(args[1], args[2], args[4]);
+		} else if (args.size() == 4 && args[0] == "--waveforms" && args[2] == "-o") {
+			UpdateWaveforms(args[1], args[3]);
 		} else {
-			/* Some invalid second param -> show the help */
 			ShowHelp(argv[0]);
-			return -1;
+			return 0;
 		}
 		if (_interactive) printf("\nDone\n");
 
@@ -0,0 +1,176 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file diff.cpp Implementation of comparing cat files */
+
+#include "stdafx.h"
+#include "diff.hpp"
+#include "catalogue.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+#include "schema.hpp"
+#include <map>
+
+/**
+ * What we know of the payload of an entry, without decoding it.
+ */
+struct PayloadInfo {
+	uint64_t hash = 0;            ///< Hash of the payload
+	uint32_t sample_rate = 0;     ///< Sample rate, or 0 for raw payloads
+	uint16_t num_channels = 0;    ///< Number of channels, or 0 for raw payloads
+	uint16_t bits_per_sample = 0; ///< Number of bits per sample, or 0 for raw payloads
+
+	/**
+	 * Get a description of the format of the payload.
+	 * @return the description
+	 */
+	std::string GetFormat() const
+	{
+		if (this->num_channels == 0) return "raw";
+		return std::to_string(this->sample_rate) + " Hz " + std::to_string(this->bits_per_sample) + " bits " + std::to_string(this->num_channels) + " channel(s)";
+	}
+};
+
+/**
+ * Index a cat file and hash the payloads of all its entries.
+ * @param reader   the reader for the cat file
+ * @param payloads where to put the information about the payloads of the entries
+ * @return the index of the cat file
+ */
+static Catalogue ReadCatalogue(Reader &reader, std::vector<PayloadInfo> &payloads)
+{
+	Catalogue catalogue(reader);
+	const std::vector<CatEntry> &entries = catalogue.GetEntries();
+	payloads.resize(entries.size());
+
+	ParallelRead(reader, entries.size(), [&](Reader &entry_reader, size_t index) {
+		const CatEntry &entry = entries[index];
+		PayloadInfo &payload = payloads[index];
+
+		/* Peek at the RIFF headers for the format of the payload. */
+		uint8_t header[RiffHeader::Layout::size];
+		if (entry.size >= sizeof(header)) {
+			entry_reader.Seek(entry.data_offset);
+			entry_reader.ReadRaw(header, sizeof(header));
+			if (RiffHeader::Layout::Validate(header)) {
+				payload.num_channels    = RiffHeader::NumChannels::Unpack(header);
+				payload.sample_rate     = RiffHeader::SampleRate::Unpack(header);
+				payload.bits_per_sample = RiffHeader::BitsPerSample::Unpack(header);
+			}
+		}
+
+		payload.hash = HashPayload(entry_reader, entry.data_offset, entry.size);
+	});
+
+	return catalogue;
+}
+
+bool DiffCat(const std::string &old_file, const std::string &new_file)
+{
+	std::unique_ptr<Reader> old_reader = OpenCatReader(old_file);
+	std::vector<PayloadInfo> old_payloads;
+	Catalogue old_cat = ReadCatalogue(*old_reader, old_payloads);
+
+	std::unique_ptr<Reader> new_reader = OpenCatReader(new_file);
+	std::vector<PayloadInfo> new_payloads;
+	Catalogue new_cat = ReadCatalogue(*new_reader, new_payloads);
+
+	const std::vector<CatEntry> &old_entries = old_cat.GetEntries();
+	const std::vector<CatEntry> &new_entries = new_cat.GetEntries();
+
+	std::map<std::string, size_t> old_names;
+	for (size_t i = 0; i < old_entries.size(); i++) old_names.emplace(old_entries[i].name, i);
+	std::map<std::string, size_t> new_names;
+	for (size_t i = 0; i < new_entries.size(); i++) new_names.emplace(new_entries[i].name, i);
+
+	if (old_cat.IsNewFormat() != new_cat.IsNewFormat()) {
+		printf("format   %s -> %s\n", old_cat.IsNewFormat() ? "new" : "old", new_cat.IsNewFormat() ? "new" : "old");
+	}
+
+	/* Samples only in the old file are removed, unless the same payload shows up under a new name. */
+	size_t modified = 0, unchanged = 0;
+	std::vector<bool> new_matched(new_entries.size(), false);
+	std::vector<size_t> removed;
+	for (size_t i = 0; i < old_entries.size(); i++) {
+		const CatEntry &old_entry = old_entries[i];
+		auto found = new_names.find(old_entry.name);
+		if (found == new_names.end()) {
+			removed.push_back(i);
+			continue;
+		}
+
+		size_t j = found->second;
+		if (new_matched[j]) {
+			/* Multiple samples with the same name; only the first one is matched. */
+			removed.push_back(i);
+			continue;
+		}
+		new_matched[j] = true;
+
+		const CatEntry &new_entry = new_entries[j];
+		const PayloadInfo &old_payload = old_payloads[i];
+		const PayloadInfo &new_payload = new_payloads[j];
+
+		std::string changes;
+		if (old_entry.filename != new_entry.filename) changes += ", filename " + old_entry.filename + " -> " + new_entry.filename;
+		if (old_payload.GetFormat() != new_payload.GetFormat()) changes += ", format " + old_payload.GetFormat() + " -> " + new_payload.GetFormat();
+		if (old_payload.hash != new_payload.hash || old_entry.size != new_entry.size) changes += ", payload " + std::to_string(old_entry.size) + " -> " + std::to_string(new_entry.size) + " bytes";
+
+		if (changes.empty()) {
+			unchanged++;
+		} else {
+			printf("modified \"%s\" (%s)\n", old_entry.name.c_str(), changes.c_str() + 2);
+			modified++;
+		}
+	}
+
+	size_t renamed = 0;
+	for (size_t i : removed) {
+		const CatEntry &old_entry = old_entries[i];
+
+		size_t j = 0;
+		for (; j < new_entries.size(); j++) {
+			if (new_matched[j] || new_payloads[j].hash != old_payloads[i].hash || new_entries[j].size != old_entry.size) continue;
+			if (old_names.count(new_entries[j].name) != 0) continue;
+			break;
+		}
+
+		if (j == new_entries.size()) {
+			printf("removed  \"%s\"\n", old_entry.name.c_str());
+			continue;
+		}
+
+		new_matched[j] = true;
+		printf("renamed  \"%s\" -> \"%s\"\n", old_entry.name.c_str(), new_entries[j].name.c_str());
+		renamed++;
+	}
+
+	size_t added = 0;
+	for (size_t j = 0; j < new_entries.size(); j++) {
+		if (new_matched[j]) continue;
+		printf("added    \"%s\"\n", new_entries[j].name.c_str());
+		added++;
+	}
+
+	size_t removed_count = removed.size() - renamed;
+	printf("%zu unchanged, %zu modified, %zu renamed, %zu added, %zu removed\n", unchanged, modified, renamed, added, removed_count);
+
+	return old_cat.IsNewFormat() == new_cat.IsNewFormat() && modified == 0 && renamed == 0 && added == 0 && removed_count == 0;
+}
@@ -0,0 +1,36 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file diff.hpp Interface for comparing cat files */
+
+#ifndef DIFF_HPP
+#define DIFF_HPP
+
+/**
+ * Compare two cat files and print the differences between their samples.
+ * The samples are compared by name, filename, format and a hash of their
+ * payload; nothing is extracted.
+ * @param old_file the cat file to compare against
+ * @param new_file the cat file to compare
+ * @return true if the cat files contain the same samples
+ */
+bool DiffCat(const std::string &old_file, const std::string &new_file);
+
+#endif /* DIFF_HPP */
@@ -0,0 +1,184 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file hash.cpp Implementation of hashing sample data */
+
+#include "stdafx.h"
+#include "hash.hpp"
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL; ///< First prime of XXH64
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL; ///< Second prime of XXH64
+static const uint64_t PRIME3 = 0x165667B19E3779F9ULL; ///< Third prime of XXH64
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL; ///< Fourth prime of XXH64
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL; ///< Fifth prime of XXH64
+
+/**
+ * Rotate the bits of a value to the left.
+ * @param value the value to rotate
+ * @param bits  the number of bits to rotate by
+ * @return the rotated value
+ */
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * Read a little endian qword from a buffer.
+ * @param data the buffer to read from
+ * @return the read qword
+ */
+static inline uint64_t Read64(const uint8_t *data)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++) value |= (uint64_t)data[i] << (8 * i);
+	return value;
+}
+
+/**
+ * Read a little endian dword from a buffer.
+ * @param data the buffer to read from
+ * @return the read dword
+ */
+static inline uint32_t Read32(const uint8_t *data)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++) value |= (uint32_t)data[i] << (8 * i);
+	return value;
+}
+
+/**
+ * Mix a qword of input into an accumulator.
+ * @param acc   the accumulator
+ * @param input the input
+ * @return the new accumulator
+ */
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+	acc += input * PRIME2;
+	acc = RotateLeft(acc, 31);
+	return acc * PRIME1;
+}
+
+/**
+ * Mix a stripe accumulator into the final hash.
+ * @param acc   the final hash
+ * @param value the stripe accumulator
+ * @return the new final hash
+ */
+static inline uint64_t MergeRound(uint64_t acc, uint64_t value)
+{
+	acc ^= Round(0, value);
+	return acc * PRIME1 + PRIME4;
+}
+
+Hasher::Hasher(uint64_t seed)
+{
+	this->acc[0] = seed + PRIME1 + PRIME2;
+	this->acc[1] = seed + PRIME2;
+	this->acc[2] = seed;
+	this->acc[3] = seed - PRIME1;
+}
+
+void Hasher::Update(const uint8_t *data, size_t amount)
+{
+	this->length += amount;
+
+	/* Complete the stripe we started on earlier. */
+	if (this->buffered != 0) {
+		size_t fill = std::min(amount, sizeof(this->buffer) - this->buffered);
+		memcpy(this->buffer + this->buffered, data, fill);
+		this->buffered += fill;
+		data += fill;
+		amount -= fill;
+
+		if (this->buffered < sizeof(this->buffer)) return;
+
+		for (int i = 0; i < 4; i++) this->acc[i] = Round(this->acc[i], Read64(this->buffer + 8 * i));
+		this->buffered = 0;
+	}
+
+	for (; amount >= sizeof(this->buffer); data += sizeof(this->buffer), amount -= sizeof(this->buffer)) {
+		for (int i = 0; i < 4; i++) this->acc[i] = Round(this->acc[i], Read64(data + 8 * i));
+	}
+
+	memcpy(this->buffer, data, amount);
+	this->buffered = amount;
+}
+
+uint64_t Hasher::GetHash() const
+{
+	uint64_t hash;
+	if (this->length >= sizeof(this->buffer)) {
+		hash = RotateLeft(this->acc[0], 1) + RotateLeft(this->acc[1], 7) + RotateLeft(this->acc[2], 12) + RotateLeft(this->acc[3], 18);
+		for (int i = 0; i < 4; i++) hash = MergeRound(hash, this->acc[i]);
+	} else {
+		/* The third accumulator still holds the seed. */
+		hash = this->acc[2] + PRIME5;
+	}
+	hash += this->length;
+
+	const uint8_t *data = this->buffer;
+	size_t amount = this->buffered;
+	for (; amount >= 8; data += 8, amount -= 8) {
+		hash ^= Round(0, Read64(data));
+		hash = RotateLeft(hash, 27) * PRIME1 + PRIME4;
+	}
+	if (amount >= 4) {
+		hash ^= Read32(data) * PRIME1;
+		hash = RotateLeft(hash, 23) * PRIME2 + PRIME3;
+		data += 4;
+		amount -= 4;
+	}
+	for (; amount > 0; data++, amount--) {
+		hash ^= *data * PRIME5;
+		hash = RotateLeft(hash, 11) * PRIME1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+uint64_t Hash(const uint8_t *data, size_t amount)
+{
+	Hasher hasher;
+	hasher.Update(data, amount);
+	return hasher.GetHash();
+}
+
+uint64_t HashPayload(Reader &reader, uint64_t offset, uint64_t length, Writer *writer)
+{
+	reader.Seek(offset);
+
+	Hasher hasher;
+	uint8_t buffer[65536];
+	while (length > 0) {
+		size_t chunk = (size_t)std::min<uint64_t>(length, sizeof(buffer));
+		reader.ReadRaw(buffer, chunk);
+		hasher.Update(buffer, chunk);
+		if (writer != nullptr) writer->WriteRaw(buffer, chunk);
+		length -= chunk;
+	}
+	return hasher.GetHash();
+}
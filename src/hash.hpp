@@ -0,0 +1,78 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file hash.hpp Interface for hashing sample data */
+
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include "io.hpp"
+
+/**
+ * Incremental 64 bits XXH64 hash. This is not a cryptographic hash; it is
+ * meant to quickly find out whether blocks of data are the same.
+ */
+class Hasher {
+	uint64_t acc[4];        ///< The accumulators for the stripes
+	uint8_t buffer[32];     ///< Data of an incomplete stripe
+	size_t buffered = 0;    ///< Amount of data in the buffer
+	uint64_t length = 0;    ///< Total amount of hashed data
+
+public:
+	/**
+	 * Start a new hash.
+	 * @param seed the seed of the hash
+	 */
+	Hasher(uint64_t seed = 0);
+
+	/**
+	 * Add data to the hash.
+	 * @param data   the data to add
+	 * @param amount the amount of bytes to add
+	 */
+	void Update(const uint8_t *data, size_t amount);
+
+	/**
+	 * Get the hash of all data added so far.
+	 * @return the hash
+	 */
+	uint64_t GetHash() const;
+};
+
+/**
+ * Get the hash of a block of data.
+ * @param data   the data to hash
+ * @param amount the amount of bytes to hash
+ * @return the hash
+ */
+uint64_t Hash(const uint8_t *data, size_t amount);
+
+/**
+ * Get the hash of a block of a source, e.g. the payload of a cat entry,
+ * without loading the whole block in memory.
+ * @param reader the source to read the block from
+ * @param offset the position of the block in the source
+ * @param length the amount of bytes of the block
+ * @param writer where to copy the block to while hashing it, if anywhere
+ * @return the hash
+ */
+uint64_t HashPayload(Reader &reader, uint64_t offset, uint64_t length, Writer *writer = nullptr);
+
+#endif /* HASH_HPP */
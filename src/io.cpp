@@ -22,49 +22,154 @@
 
 #include "stdafx.h"
 #include "io.hpp"
+#include "progress.hpp"
 
-FileReader::FileReader(const std::string &filename, bool binary)
-{
-	this->file = fopen(filename.c_str(), binary ? "rb" : "r");
-	fseek(this->file, 0, SEEK_END);
-	this->filesize = ftell(this->file);
-	fseek(this->file, 0, SEEK_SET);
-	this->filename = filename;
+#if !defined(WIN32)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
 
-	if (this->file == NULL) {
-		throw "Could not open " + filename + " for reading";
-	}
-}
-
-FileReader::~FileReader()
-{
-	fclose(this->file);
-}
-
-uint8_t FileReader::ReadByte()
+uint8_t Reader::ReadByte()
 {
 	uint8_t b;
 	this->ReadRaw(&b, 1);
 	return b;
 }
 
-uint16_t FileReader::ReadWord()
+uint16_t Reader::ReadWord()
 {
 	uint16_t b = this->ReadByte();
 	return (this->ReadByte() << 8) | b;
 }
 
-uint32_t FileReader::ReadDword()
+uint32_t Reader::ReadDword()
 {
 	uint32_t b = this->ReadWord();
 	return (this->ReadWord() << 16) | b;
 }
 
+std::unique_ptr<Reader> Reader::OpenCursor() const
+{
+	return nullptr;
+}
+
+void Reader::ReleaseBefore(uint64_t)
+{
+}
+
+const std::string &Reader::GetFilename() const
+{
+	return this->filename;
+}
+
+
+void Writer::WriteByte(uint8_t data)
+{
+	this->WriteRaw(&data, 1);
+}
+
+void Writer::WriteWord(uint16_t data)
+{
+	this->WriteByte(data & 0xFF);
+	this->WriteByte(data >> 8);
+}
+
+void Writer::WriteDword(uint32_t data)
+{
+	this->WriteWord(data & 0xFFFF);
+	this->WriteWord(data >> 16);
+}
+
+void Writer::WriteString(const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	int length = vsnprintf(nullptr, 0, format, ap);
+	va_end(ap);
+	if (length < 0) throw "Unexpected failure while writing to " + this->filename;
+
+	std::vector<char> buffer(length + 1);
+	va_start(ap, format);
+	vsnprintf(buffer.data(), buffer.size(), format, ap);
+	va_end(ap);
+
+	this->WriteRaw((const uint8_t *)buffer.data(), length);
+}
+
+const std::string &Writer::GetFilename() const
+{
+	return this->filename;
+}
+
+
+/** Number of bytes to read ahead and to release from the cache at once when reading sequentially */
+static const uint64_t RELEASE_WINDOW = 8 * 1024 * 1024;
+
+/** Alignment of the position, the size and the buffer of direct reads */
+static const size_t DIRECT_ALIGNMENT = 4096;
+
+/** Size of the buffer of direct reads */
+static const size_t DIRECT_BUFFER_SIZE = 1024 * 1024;
+
+/** Size of the buffer of every cursor of a positional reader */
+static const size_t POSITIONAL_BUFFER_SIZE = 64 * 1024;
+
+FileReader::FileReader(const std::string &filename, bool binary, AccessHint hint) : Reader(filename), hint(hint)
+{
+	this->file = fopen(filename.c_str(), binary ? "rb" : "r");
+
+	if (this->file == NULL) {
+		throw "Could not open " + filename + " for reading";
+	}
+
+	fseeko(this->file, 0, SEEK_END);
+	this->filesize = ftello(this->file);
+	fseeko(this->file, 0, SEEK_SET);
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+	if (this->hint == AccessHint::Sequential) {
+		posix_fadvise(fileno(this->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+		posix_fadvise(fileno(this->file), 0, RELEASE_WINDOW, POSIX_FADV_WILLNEED);
+	}
+#endif
+}
+
+FileReader::~FileReader()
+{
+#if defined(POSIX_FADV_DONTNEED)
+	if (this->hint == AccessHint::Sequential) posix_fadvise(fileno(this->file), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	fclose(this->file);
+}
+
 void FileReader::ReadRaw(uint8_t *in, size_t amount)
 {
 	if (fread(in, 1, amount, this->file) != amount) {
 		throw "Unexpected end of " + this->filename;
 	}
+
+	if (this->hint == AccessHint::Sequential) {
+		this->unreleased += amount;
+		if (this->unreleased >= RELEASE_WINDOW) this->ReleaseBehind();
+	}
+}
+
+void FileReader::ReleaseBehind()
+{
+	this->unreleased = 0;
+
+#if defined(POSIX_FADV_DONTNEED)
+	/* Everything up to the current position has been read; the data that
+	 * is buffered by stdio is beyond it, so it does not matter either. */
+	uint64_t pos = this->GetPos();
+	if (pos > this->released) {
+		posix_fadvise(fileno(this->file), (off_t)this->released, (off_t)(pos - this->released), POSIX_FADV_DONTNEED);
+		this->released = pos;
+	}
+	posix_fadvise(fileno(this->file), (off_t)pos, RELEASE_WINDOW, POSIX_FADV_WILLNEED);
+#endif
 }
 
 char *FileReader::ReadLine(char *in, int length)
@@ -77,26 +182,20 @@ char *FileReader::ReadLine(char *in, int length)
 	return ret;
 }
 
-void FileReader::Seek(uint32_t pos)
+void FileReader::Seek(uint64_t pos)
 {
-	if (fseek(this->file, pos, SEEK_SET) != 0) throw "Seeking in " + this->filename + " failed.";
+	if (fseeko(this->file, pos, SEEK_SET) != 0) throw "Seeking in " + this->filename + " failed.";
 }
 
-uint32_t FileReader::GetPos()
+uint64_t FileReader::GetPos()
 {
-	return ftell(this->file);
-}
-
-const std::string &FileReader::GetFilename() const
-{
-	return this->filename;
+	return ftello(this->file);
 }
 
 
-FileWriter::FileWriter(const std::string &filename, bool binary)
+FileWriter::FileWriter(const std::string &filename, bool binary) : Writer(filename)
 {
 	this->filename_new = filename + ".new";
-	this->filename = filename;
 
 	this->file = fopen(filename_new.c_str(), binary ? "w+b" : "w+");
 
@@ -113,55 +212,67 @@ FileWriter::~FileWriter()
 	}
 }
 
-void FileWriter::WriteByte(uint8_t data)
-{
-	this->WriteRaw(&data, 1);
-}
-
-void FileWriter::WriteWord(uint16_t data)
-{
-	this->WriteByte(data & 0xFF);
-	this->WriteByte(data >> 8);
-}
-
-void FileWriter::WriteDword(uint32_t data)
-{
-	this->WriteWord(data & 0xFFFF);
-	this->WriteWord(data >> 16);
-}
-
 void FileWriter::WriteRaw(const uint8_t *out, size_t amount)
 {
 	assert(this->file != NULL);
+	if (amount == 0) return;
 
 	if (fwrite(out, 1, amount, this->file) != amount) {
 		throw "Unexpected failure while writing to " + this->filename;
 	}
 }
 
-void FileWriter::WriteString(const char *format, ...)
+void FileWriter::WriteRawAt(uint64_t pos, const uint8_t *out, size_t amount)
 {
 	assert(this->file != NULL);
 
-	va_list ap;
-
-	va_start(ap, format);
-	if (vfprintf(this->file, format, ap) < 0) {
+#if defined(WIN32)
+	/* There is no positional write, so seeking and writing must happen in one go. */
+	std::lock_guard<std::mutex> guard(this->positional_lock);
+	if (fseeko(this->file, pos, SEEK_SET) != 0 || fwrite(out, 1, amount, this->file) != amount) {
 		throw "Unexpected failure while writing to " + this->filename;
 	}
-	va_end(ap);
+#else
+	int fd = fileno(this->file);
+	while (amount > 0) {
+		ssize_t written = pwrite(fd, out, amount, (off_t)pos);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			throw "Unexpected failure while writing to " + this->filename;
+		}
+		out += written;
+		pos += written;
+		amount -= written;
+	}
+#endif
 }
 
-uint32_t FileWriter::GetPos()
+void FileWriter::Preallocate(uint64_t size)
 {
 	assert(this->file != NULL);
 
-	return ftell(this->file);
+	if (fflush(this->file) != 0) throw "Unexpected failure while writing to " + this->filename;
+
+#if defined(WIN32)
+	if (_chsize_s(fileno(this->file), size) != 0) throw "Could not resize " + this->filename;
+#else
+	int fd = fileno(this->file);
+#if defined(__linux__)
+	/* Reserve the space, so running out of disk space is noticed before writing anything. */
+	int error = posix_fallocate(fd, 0, (off_t)size);
+	if (error == 0) return;
+	if (error != EINVAL && error != EOPNOTSUPP) throw "Could not reserve space for " + this->filename + " (" + strerror(error) + ")";
+#endif
+	/* The file system cannot reserve space, so just make the file large enough. */
+	if (ftruncate(fd, (off_t)size) != 0) throw "Could not resize " + this->filename;
+#endif
 }
 
-const std::string &FileWriter::GetFilename() const
+uint64_t FileWriter::GetPos()
 {
-	return this->filename;
+	assert(this->file != NULL);
+
+	return ftello(this->file);
 }
 
 void FileWriter::Close()
@@ -173,17 +284,434 @@ void FileWriter::Close()
 	/* Then remove the existing .bak file */
 	std::string filename_bak = this->filename + ".bak";
 	if (unlink(filename_bak.c_str()) != 0 && errno != ENOENT) {
-		fprintf(stderr, "Warning: could not remove %s (%s)\n", filename_bak.c_str(), strerror(errno));
+		ShowWarning("could not remove %s (%s)", filename_bak.c_str(), strerror(errno));
 	}
 
 	/* Then move the existing file to .bak */
 	if (rename(this->filename.c_str(), filename_bak.c_str()) != 0 && errno != ENOENT) {
-		fprintf(stderr, "Warning: could not rename %s to %s (%s)\n", this->filename.c_str(), filename_bak.c_str(), strerror(errno));
+		ShowWarning("could not rename %s to %s (%s)", this->filename.c_str(), filename_bak.c_str(), strerror(errno));
 	}
 
 	/* And finally move the .new file to the actual wanted filename */
 	if (rename(this->filename_new.c_str(), this->filename.c_str()) != 0) {
-		fprintf(stderr, "Warning: could not rename %s to %s (%s)\n", this->filename_new.c_str(), this->filename.c_str(), strerror(errno));
+		ShowWarning("could not rename %s to %s (%s)", this->filename_new.c_str(), this->filename.c_str(), strerror(errno));
 		throw "Could not close " + this->filename;
 	}
 }
+
+
+void MemoryReader::ReadRaw(uint8_t *in, size_t amount)
+{
+	if (amount > this->size - this->pos) {
+		throw "Unexpected end of " + this->filename;
+	}
+	memcpy(in, this->data + this->pos, amount);
+	this->pos += amount;
+}
+
+char *MemoryReader::ReadLine(char *in, int length)
+{
+	if (this->pos == this->size) return NULL;
+
+	/* Like fgets, read up to and including the newline, if it fits. */
+	int i = 0;
+	while (i < length - 1 && this->pos < this->size) {
+		char c = (char)this->data[this->pos++];
+		in[i++] = c;
+		if (c == '\n') break;
+	}
+	in[i] = '\0';
+
+	return in;
+}
+
+void MemoryReader::Seek(uint64_t pos)
+{
+	if (pos > this->size) throw "Seeking in " + this->filename + " failed.";
+	this->pos = (size_t)pos;
+}
+
+uint64_t MemoryReader::GetPos()
+{
+	return this->pos;
+}
+
+std::unique_ptr<Reader> MemoryReader::OpenCursor() const
+{
+	return std::make_unique<MemoryReader>(this->data, this->size, this->filename);
+}
+
+
+MappedReader::MappedReader(const std::string &filename, AccessHint hint) : MemoryReader(filename)
+{
+#if defined(WIN32)
+	/* No mapping here, so just load the whole file. */
+	FileReader reader(filename);
+	if (reader.GetSize() > SIZE_MAX) throw "File too large to load " + filename;
+	this->buffer.resize((size_t)reader.GetSize());
+	reader.ReadRaw(this->buffer.data(), this->buffer.size());
+	this->data = this->buffer.data();
+	this->size = this->buffer.size();
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw "Could not open " + filename + " for reading";
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (uint64_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		throw "Could not open " + filename + " for reading";
+	}
+	this->size = (size_t)st.st_size;
+
+	/* Mapping nothing is not allowed, but there is nothing to read anyway. */
+	if (this->size != 0) {
+		void *mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED) {
+			close(fd);
+			throw "Could not map " + filename + " into memory";
+		}
+		this->data = (const uint8_t *)mapping;
+
+#if defined(MADV_SEQUENTIAL)
+		if (hint == AccessHint::Sequential) madvise(mapping, this->size, MADV_SEQUENTIAL);
+#endif
+	}
+	close(fd);
+#endif
+}
+
+MappedReader::~MappedReader()
+{
+#if !defined(WIN32)
+	if (this->data != nullptr) munmap((void *)this->data, this->size);
+#endif
+}
+
+
+#if defined(__linux__)
+
+DirectReader::DirectReader(const std::string &filename) : Reader(filename)
+{
+	this->fd = open(filename.c_str(), O_RDONLY | O_DIRECT);
+	this->direct = this->fd >= 0;
+	if (!this->direct && errno == EINVAL) {
+		/* The file system does not support direct access; do our best. */
+		this->fd = open(filename.c_str(), O_RDONLY);
+	}
+	if (this->fd < 0) throw "Could not open " + filename + " for reading";
+
+	struct stat st;
+	if (fstat(this->fd, &st) != 0 || posix_memalign((void **)&this->buffer, DIRECT_ALIGNMENT, DIRECT_BUFFER_SIZE) != 0) {
+		close(this->fd);
+		throw "Could not open " + filename + " for reading";
+	}
+	this->filesize = (uint64_t)st.st_size;
+}
+
+DirectReader::~DirectReader()
+{
+	free(this->buffer);
+	close(this->fd);
+}
+
+void DirectReader::Fill()
+{
+	this->buffer_start = this->pos & ~(uint64_t)(DIRECT_ALIGNMENT - 1);
+	this->buffer_length = 0;
+
+	for (;;) {
+		ssize_t length = pread(this->fd, this->buffer, DIRECT_BUFFER_SIZE, (off_t)this->buffer_start);
+		if (length < 0 && errno == EINTR) continue;
+		if (length < 0) throw "Reading " + this->filename + " failed";
+
+		this->buffer_length = (size_t)length;
+		break;
+	}
+
+	if (!this->direct) posix_fadvise(this->fd, (off_t)this->buffer_start, (off_t)this->buffer_length, POSIX_FADV_DONTNEED);
+}
+
+void DirectReader::ReadRaw(uint8_t *in, size_t amount)
+{
+	while (amount > 0) {
+		if (this->pos < this->buffer_start || this->pos >= this->buffer_start + this->buffer_length) {
+			this->Fill();
+			if (this->pos >= this->buffer_start + this->buffer_length) throw "Unexpected end of " + this->filename;
+		}
+
+		size_t offset = (size_t)(this->pos - this->buffer_start);
+		size_t chunk = std::min(amount, this->buffer_length - offset);
+		memcpy(in, this->buffer + offset, chunk);
+
+		in += chunk;
+		amount -= chunk;
+		this->pos += chunk;
+	}
+}
+
+char *DirectReader::ReadLine(char *in, int length)
+{
+	if (this->pos >= this->filesize) return NULL;
+
+	/* Like fgets, read up to and including the newline, if it fits. */
+	int i = 0;
+	while (i < length - 1 && this->pos < this->filesize) {
+		uint8_t c;
+		this->ReadRaw(&c, 1);
+		in[i++] = (char)c;
+		if (c == '\n') break;
+	}
+	in[i] = '\0';
+
+	return in;
+}
+
+void DirectReader::Seek(uint64_t pos)
+{
+	if (pos > this->filesize) throw "Seeking in " + this->filename + " failed.";
+	this->pos = pos;
+}
+
+uint64_t DirectReader::GetPos()
+{
+	return this->pos;
+}
+
+#else /* __linux__ */
+
+DirectReader::DirectReader(const std::string &filename) : Reader(filename)
+{
+	throw std::string("Direct access to files is not supported on this platform");
+}
+
+DirectReader::~DirectReader()
+{
+}
+
+void DirectReader::Fill()
+{
+}
+
+void DirectReader::ReadRaw(uint8_t *, size_t)
+{
+}
+
+char *DirectReader::ReadLine(char *, int)
+{
+	return NULL;
+}
+
+void DirectReader::Seek(uint64_t)
+{
+}
+
+uint64_t DirectReader::GetPos()
+{
+	return 0;
+}
+
+#endif /* __linux__ */
+
+
+/** The file that is shared by all cursors of a positional reader. */
+struct PositionalReader::File {
+	FILE *file = nullptr;  ///< The opened file
+	uint64_t filesize = 0; ///< The size of the file
+	AccessHint hint;       ///< How the file is going to be read
+	uint64_t released = 0; ///< Position up to which the cache has been released
+#if defined(WIN32)
+	std::mutex lock;       ///< Lock for reads, as they have to seek
+#endif
+
+	/**
+	 * Cleans up our mess
+	 */
+	~File()
+	{
+#if defined(POSIX_FADV_DONTNEED)
+		if (this->hint == AccessHint::Sequential) posix_fadvise(fileno(this->file), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+		fclose(this->file);
+	}
+};
+
+PositionalReader::PositionalReader(const std::string &filename, AccessHint hint) : Reader(filename), buffer(POSITIONAL_BUFFER_SIZE)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (file == NULL) throw "Could not open " + filename + " for reading";
+
+	this->file = std::make_shared<File>();
+	this->file->file = file;
+	this->file->hint = hint;
+
+	fseeko(file, 0, SEEK_END);
+	this->file->filesize = ftello(file);
+	fseeko(file, 0, SEEK_SET);
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+	if (hint == AccessHint::Sequential) {
+		posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+		posix_fadvise(fileno(file), 0, RELEASE_WINDOW, POSIX_FADV_WILLNEED);
+	}
+#endif
+}
+
+PositionalReader::PositionalReader(std::shared_ptr<File> file, const std::string &filename) : Reader(filename), file(std::move(file)), buffer(POSITIONAL_BUFFER_SIZE), cursor(true)
+{
+}
+
+size_t PositionalReader::ReadAt(uint64_t pos, uint8_t *in, size_t amount)
+{
+#if defined(WIN32)
+	/* There is no positional read, so seeking and reading must happen in one go. */
+	std::lock_guard<std::mutex> guard(this->file->lock);
+	if (fseeko(this->file->file, pos, SEEK_SET) != 0) throw "Seeking in " + this->filename + " failed.";
+	size_t length = fread(in, 1, amount, this->file->file);
+	if (length != amount && ferror(this->file->file)) throw "Reading " + this->filename + " failed";
+	return length;
+#else
+	int fd = fileno(this->file->file);
+	size_t done = 0;
+	while (done < amount) {
+		ssize_t length = pread(fd, in + done, amount - done, (off_t)(pos + done));
+		if (length < 0 && errno == EINTR) continue;
+		if (length < 0) throw "Reading " + this->filename + " failed";
+		if (length == 0) break;
+		done += (size_t)length;
+	}
+	return done;
+#endif
+}
+
+void PositionalReader::ReadRaw(uint8_t *in, size_t amount)
+{
+	/* Cursors read wherever they are needed, so only the reader itself knows what is behind it. */
+	if (!this->cursor && this->file->hint == AccessHint::Sequential) {
+		if (this->unreleased >= RELEASE_WINDOW) this->ReleaseBefore(this->pos);
+		this->unreleased += amount;
+	}
+
+	while (amount > 0) {
+		if (this->pos >= this->buffer_start && this->pos < this->buffer_start + this->buffer_length) {
+			size_t offset = (size_t)(this->pos - this->buffer_start);
+			size_t chunk = std::min(amount, this->buffer_length - offset);
+			memcpy(in, this->buffer.data() + offset, chunk);
+
+			in += chunk;
+			amount -= chunk;
+			this->pos += chunk;
+			continue;
+		}
+
+		/* Large reads, like the sample data, do not need to go through the buffer. */
+		if (amount >= this->buffer.size()) {
+			if (this->ReadAt(this->pos, in, amount) != amount) throw "Unexpected end of " + this->filename;
+			this->pos += amount;
+			return;
+		}
+
+		this->buffer_start = this->pos;
+		this->buffer_length = this->ReadAt(this->pos, this->buffer.data(), this->buffer.size());
+		if (this->buffer_length == 0) throw "Unexpected end of " + this->filename;
+	}
+}
+
+char *PositionalReader::ReadLine(char *in, int length)
+{
+	if (this->pos >= this->GetSize()) return NULL;
+
+	/* Like fgets, read up to and including the newline, if it fits. */
+	int i = 0;
+	while (i < length - 1 && this->pos < this->GetSize()) {
+		uint8_t c;
+		this->ReadRaw(&c, 1);
+		in[i++] = (char)c;
+		if (c == '\n') break;
+	}
+	in[i] = '\0';
+
+	return in;
+}
+
+void PositionalReader::Seek(uint64_t pos)
+{
+	if (pos > this->GetSize()) throw "Seeking in " + this->filename + " failed.";
+	this->pos = pos;
+}
+
+uint64_t PositionalReader::GetPos()
+{
+	return this->pos;
+}
+
+uint64_t PositionalReader::GetSize() const
+{
+	return this->file->filesize;
+}
+
+std::unique_ptr<Reader> PositionalReader::OpenCursor() const
+{
+	return std::unique_ptr<Reader>(new PositionalReader(this->file, this->filename));
+}
+
+void PositionalReader::ReleaseBefore(uint64_t pos)
+{
+	this->unreleased = 0;
+
+#if defined(POSIX_FADV_DONTNEED)
+	if (this->file->hint != AccessHint::Sequential) return;
+
+	int fd = fileno(this->file->file);
+	if (pos > this->file->released) {
+		posix_fadvise(fd, (off_t)this->file->released, (off_t)(pos - this->file->released), POSIX_FADV_DONTNEED);
+		this->file->released = pos;
+	}
+	posix_fadvise(fd, (off_t)pos, RELEASE_WINDOW, POSIX_FADV_WILLNEED);
+#endif
+}
+
+
+void MemoryWriter::WriteRaw(const uint8_t *out, size_t amount)
+{
+	if (amount == 0) return;
+	if (this->pos + amount > this->data.size()) this->data.resize(this->pos + amount);
+	memcpy(this->data.data() + this->pos, out, amount);
+	this->pos += amount;
+}
+
+void MemoryWriter::WriteRawAt(uint64_t pos, const uint8_t *out, size_t amount)
+{
+	/* Growing the buffer is not safe while other threads write into it. */
+	if (pos > this->data.size() || amount > this->data.size() - pos) {
+		throw "Unexpected failure while writing to " + this->filename;
+	}
+	if (amount != 0) memcpy(this->data.data() + pos, out, amount);
+}
+
+void MemoryWriter::Preallocate(uint64_t size)
+{
+	if (size > SIZE_MAX) throw "Could not resize " + this->filename;
+	this->data.resize((size_t)size);
+}
+
+uint64_t MemoryWriter::GetPos()
+{
+	return this->pos;
+}
+
+void MemoryWriter::Close()
+{
+}
+
+
+void CopyRaw(Reader &reader, Writer &writer, uint64_t amount)
+{
+	uint8_t buffer[65536];
+
+	while (amount > 0) {
+		size_t chunk = (size_t)std::min<uint64_t>(amount, sizeof(buffer));
+		reader.ReadRaw(buffer, chunk);
+		writer.WriteRaw(buffer, chunk);
+		amount -= chunk;
+	}
+}
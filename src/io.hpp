@@ -23,26 +23,34 @@
 #ifndef IO_H
 #define IO_H
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** How a file is going to be read, so the operating system can prepare for it. */
+enum class AccessHint {
+	Normal,     ///< No particular pattern; leave it to the operating system
+	Sequential, ///< Read once from begin to end; what has been read is not kept in the cache
+};
+
 /**
- * Simple class to perform binary and string reading from a file.
+ * Interface to perform binary and string reading from some source.
  */
-class FileReader {
-	FILE *file;      ///< The file to be read by this instance
-	size_t filesize; ///< The size of the file
-	std::string filename; ///< The filename of the file
+class Reader {
+protected:
+	std::string filename; ///< The filename of the source
 
 public:
 	/**
-	 * Create a new reader for the given file.
-	 * @param filename the file to read from
-	 * @param binary   read the file as binary or text?
+	 * Create a new reader.
+	 * @param filename the filename of the source, used for messages
 	 */
-	FileReader(const std::string &filename, bool binary = true);
+	Reader(const std::string &filename) : filename(filename) {}
 
 	/**
 	 * Cleans up our mess
 	 */
-	~FileReader();
+	virtual ~Reader() = default;
 
 
 	/**
@@ -68,61 +76,74 @@ public:
 	 * @param in     the buffer where to put the data
 	 * @param amount the amount of bytes to read
 	 */
-	void ReadRaw(uint8_t *in, size_t amount);
+	virtual void ReadRaw(uint8_t *in, size_t amount) = 0;
 
 	/**
 	 * Read a line of text from the stream.
 	 * @param in     the buffer where to put the data
 	 * @param length the maximum amount of bytes to read
+	 * @return the buffer, or NULL when there is nothing left to read
 	 */
-	char *ReadLine(char *in, int length);
+	virtual char *ReadLine(char *in, int length) = 0;
 
 
 	/**
 	 * Go to a specific location in the stream.
 	 * @param pos the position to go to.
 	 */
-	void Seek(uint32_t pos);
+	virtual void Seek(uint64_t pos) = 0;
 
 	/**
 	 * Get the current position in the stream.
 	 * @return the position in the stream
 	 */
-	uint32_t GetPos();
+	virtual uint64_t GetPos() = 0;
+
+	/**
+	 * Get the size of the source.
+	 * @return the size of the source
+	 */
+	virtual uint64_t GetSize() const = 0;
 
 	/**
-	 * Get the size of the file.
-	 * @return the size of the file
+	 * Create a new reader of the same source with its own position, which
+	 * can be used at the same time as this reader from another thread.
+	 * @return the new reader, which must not outlive this reader, or nullptr when the source can not be read concurrently
 	 */
-	inline size_t GetSize() const { return this->filesize; }
+	virtual std::unique_ptr<Reader> OpenCursor() const;
 
 	/**
-	 * Get the filename of this file.
+	 * Tell the source that everything before the given position has been
+	 * read and will not be read again, so it does not need to be cached.
+	 * @param pos the position up to which the source has been read
+	 */
+	virtual void ReleaseBefore(uint64_t pos);
+
+	/**
+	 * Get the filename of this source.
 	 * @return the filename
 	 */
 	const std::string &GetFilename() const;
 };
 
 /**
- * Simple class to perform binary and string writing to a file.
+ * Interface to perform binary and string writing to some destination.
  */
-class FileWriter {
-	FILE *file;          ///< The file to be read by this instance
-	std::string filename;     ///< The filename of the file
-	std::string filename_new; ///< The filename for the temporary file
+class Writer {
+protected:
+	std::string filename; ///< The filename of the destination
 
 public:
 	/**
-	 * Create a new writer for the given file.
-	 * @param filename the file to write to
-	 * @param binary   write the file as binary or text?
+	 * Create a new writer.
+	 * @param filename the filename of the destination, used for messages
 	 */
-	FileWriter(const std::string &filename, bool binary = true);
+	Writer(const std::string &filename) : filename(filename) {}
 
 	/**
 	 * Cleans up our mess
 	 */
-	~FileWriter();
+	virtual ~Writer() = default;
 
 	/**
 	 * Write a single byte to the stream.
@@ -147,7 +168,27 @@ public:
 	 * @param out    the buffer of data to write
 	 * @param amount the amount of bytes to write
 	 */
-	void WriteRaw(const uint8_t *out, size_t amount);
+	virtual void WriteRaw(const uint8_t *out, size_t amount) = 0;
+
+	/**
+	 * Write a number of raw bytes at a given position, without using the
+	 * current position of the stream. Multiple threads may do this at the
+	 * same time for different parts of the destination, as long as those
+	 * parts have been allocated with Preallocate. Afterwards the current
+	 * position of the stream is undefined.
+	 * @param pos    the position to write at
+	 * @param out    the buffer of data to write
+	 * @param amount the amount of bytes to write
+	 */
+	virtual void WriteRawAt(uint64_t pos, const uint8_t *out, size_t amount) = 0;
+
+	/**
+	 * Make the destination the given size and reserve the space where
+	 * possible, so it can be written with WriteRawAt. Anything written to
+	 * the stream so far is kept.
+	 * @param size the size of the destination
+	 */
+	virtual void Preallocate(uint64_t size) = 0;
 
 	/**
 	 * Write a line of text to the stream.
@@ -160,19 +201,279 @@ public:
 	 * Get the current position in the stream.
 	 * @return the position in the stream
 	 */
-	uint32_t GetPos();
+	virtual uint64_t GetPos() = 0;
 
 	/**
-	 * Get the filename of this file.
+	 * Get the filename of this destination.
 	 * @return the filename
 	 */
 	const std::string &GetFilename() const;
 
 	/**
-	 * Close the output, i.e. commit the file to disk.
-	 * If this is not done, the file with not be written to disk.
+	 * Close the output, i.e. commit the written data.
+	 * If this is not done, the data will not be committed.
+	 */
+	virtual void Close() = 0;
+};
+
+
+/**
+ * Simple class to perform binary and string reading from a file.
+ */
+class FileReader : public Reader {
+	FILE *file;              ///< The file to be read by this instance
+	uint64_t filesize;       ///< The size of the file
+	AccessHint hint;         ///< How the file is going to be read
+	uint64_t unreleased = 0; ///< Number of bytes read since the cache was last released
+	uint64_t released = 0;   ///< Position up to which the cache has been released
+
+	/**
+	 * Tell the operating system it can drop what has been read from its
+	 * cache, and read the next part of the file ahead.
+	 */
+	void ReleaseBehind();
+
+public:
+	/**
+	 * Create a new reader for the given file.
+	 * @param filename the file to read from
+	 * @param binary   read the file as binary or text?
+	 * @param hint     how the file is going to be read
+	 */
+	FileReader(const std::string &filename, bool binary = true, AccessHint hint = AccessHint::Normal);
+
+	/**
+	 * Cleans up our mess
 	 */
-	void Close();
+	~FileReader() override;
+
+	void ReadRaw(uint8_t *in, size_t amount) override;
+	char *ReadLine(char *in, int length) override;
+	void Seek(uint64_t pos) override;
+	uint64_t GetPos() override;
+	inline uint64_t GetSize() const override { return this->filesize; }
 };
 
+/**
+ * Simple class to perform binary and string writing to a file. The data is
+ * written to a temporary file, which replaces the actual file on Close.
+ */
+class FileWriter : public Writer {
+	FILE *file;               ///< The file to be read by this instance
+	std::string filename_new; ///< The filename for the temporary file
+#if defined(WIN32)
+	std::mutex positional_lock; ///< Lock for positional writes, as they have to seek
+#endif
+
+public:
+	/**
+	 * Create a new writer for the given file.
+	 * @param filename the file to write to
+	 * @param binary   write the file as binary or text?
+	 */
+	FileWriter(const std::string &filename, bool binary = true);
+
+	/**
+	 * Cleans up our mess
+	 */
+	~FileWriter() override;
+
+	void WriteRaw(const uint8_t *out, size_t amount) override;
+	void WriteRawAt(uint64_t pos, const uint8_t *out, size_t amount) override;
+	void Preallocate(uint64_t size) override;
+	uint64_t GetPos() override;
+
+	/**
+	 * Close the output, i.e. commit the file to disk, keeping the
+	 * previous version of the file as backup.
+	 */
+	void Close() override;
+};
+
+/**
+ * Reader of data that is already in memory.
+ */
+class MemoryReader : public Reader {
+protected:
+	const uint8_t *data = nullptr; ///< The data to read
+	size_t size = 0;               ///< The size of the data
+	size_t pos = 0;                ///< The current position in the data
+
+	/**
+	 * Create a new reader, of which the data is set later on.
+	 * @param filename the filename of the data, used for messages
+	 */
+	MemoryReader(const std::string &filename) : Reader(filename) {}
+
+public:
+	/**
+	 * Create a new reader for data in memory.
+	 * @param data     the data to read; must outlive the reader
+	 * @param size     the size of the data
+	 * @param filename the filename of the data, used for messages
+	 */
+	MemoryReader(const uint8_t *data, size_t size, const std::string &filename) : Reader(filename), data(data), size(size) {}
+
+	void ReadRaw(uint8_t *in, size_t amount) override;
+	char *ReadLine(char *in, int length) override;
+	void Seek(uint64_t pos) override;
+	uint64_t GetPos() override;
+	inline uint64_t GetSize() const override { return this->size; }
+	std::unique_ptr<Reader> OpenCursor() const override;
+
+	/**
+	 * Get the data that is read.
+	 * @return the data
+	 */
+	inline const uint8_t *GetData() const { return this->data; }
+};
+
+/**
+ * Reader of a file that is mapped into memory, so the operating system
+ * pages it in on demand. Where mapping is not supported the whole file is
+ * loaded into memory instead.
+ */
+class MappedReader : public MemoryReader {
+#if defined(WIN32)
+	std::vector<uint8_t> buffer; ///< The contents of the file
+#endif
+
+public:
+	/**
+	 * Create a new reader for the given file.
+	 * @param filename the file to read from
+	 * @param hint     how the file is going to be read
+	 */
+	MappedReader(const std::string &filename, AccessHint hint = AccessHint::Normal);
+
+	/**
+	 * Cleans up our mess
+	 */
+	~MappedReader() override;
+};
+
+/**
+ * Reader of a file that bypasses the cache of the operating system, by
+ * reading aligned blocks directly into its own buffer. When the file system
+ * does not support that, every block is dropped from the cache right after
+ * reading it instead. This is only supported on Linux.
+ */
+class DirectReader : public Reader {
+	int fd = -1;                 ///< The file to be read by this instance
+	bool direct = false;         ///< Whether the file could be opened for direct access
+	uint64_t filesize = 0;       ///< The size of the file
+	uint8_t *buffer = nullptr;   ///< Aligned buffer with a block of the file
+	uint64_t buffer_start = 0;   ///< Position in the file of the begin of the buffer
+	size_t buffer_length = 0;    ///< Number of bytes of the file in the buffer
+	uint64_t pos = 0;            ///< The current position in the file
+
+	/**
+	 * Fill the buffer with the block of the file the current position is in.
+	 */
+	void Fill();
+
+public:
+	/**
+	 * Create a new reader for the given file.
+	 * @param filename the file to read from
+	 */
+	DirectReader(const std::string &filename);
+
+	/**
+	 * Cleans up our mess
+	 */
+	~DirectReader() override;
+
+	void ReadRaw(uint8_t *in, size_t amount) override;
+	char *ReadLine(char *in, int length) override;
+	void Seek(uint64_t pos) override;
+	uint64_t GetPos() override;
+	inline uint64_t GetSize() const override { return this->filesize; }
+};
+
+/**
+ * Reader of a file that reads at explicit offsets instead of the shared
+ * position of the file. All cursors of the file share the opened file, but
+ * each has its own position and buffer, so any number of threads can read
+ * from their own cursor at the same time without locking. When the file is
+ * read sequentially, the reader itself releases the cache behind it like
+ * FileReader; for what the cursors read, the cache is only released when
+ * told so with ReleaseBefore.
+ */
+class PositionalReader : public Reader {
+	struct File;
+
+	std::shared_ptr<File> file;  ///< The file shared by all cursors
+	std::vector<uint8_t> buffer; ///< Buffer with a block of the file
+	uint64_t buffer_start = 0;   ///< Position in the file of the begin of the buffer
+	size_t buffer_length = 0;    ///< Number of bytes of the file in the buffer
+	uint64_t pos = 0;            ///< The current position in the file
+	bool cursor = false;         ///< Whether this is a cursor opened by another reader of the file
+	uint64_t unreleased = 0;     ///< Number of bytes read since the cache was last released
+
+	/**
+	 * Create a new cursor for an already opened file.
+	 * @param file     the opened file
+	 * @param filename the file to read from
+	 */
+	PositionalReader(std::shared_ptr<File> file, const std::string &filename);
+
+	/**
+	 * Read a block of the file, without using the buffer.
+	 * @param pos    the position in the file to read from
+	 * @param in     the buffer where to put the data
+	 * @param amount the maximum amount of bytes to read
+	 * @return the amount of bytes read; less than asked only at the end of the file
+	 */
+	size_t ReadAt(uint64_t pos, uint8_t *in, size_t amount);
+
+public:
+	/**
+	 * Create a new reader for the given file.
+	 * @param filename the file to read from
+	 * @param hint     how the file is going to be read
+	 */
+	PositionalReader(const std::string &filename, AccessHint hint = AccessHint::Normal);
+
+	void ReadRaw(uint8_t *in, size_t amount) override;
+	char *ReadLine(char *in, int length) override;
+	void Seek(uint64_t pos) override;
+	uint64_t GetPos() override;
+	uint64_t GetSize() const override;
+	std::unique_ptr<Reader> OpenCursor() const override;
+	void ReleaseBefore(uint64_t pos) override;
+};
+
+/**
+ * Writer of data into memory. Closing it does nothing, as the data is
+ * available as soon as it is written.
+ */
+class MemoryWriter : public Writer {
+	std::vector<uint8_t> &data; ///< The written data
+	size_t pos = 0;             ///< The current position in the data
+
+public:
+	/**
+	 * Create a new writer into memory.
+	 * @param data     the buffer to write into; anything in it is thrown away
+	 * @param filename the filename of the data, used for messages
+	 */
+	MemoryWriter(std::vector<uint8_t> &data, const std::string &filename) : Writer(filename), data(data) { data.clear(); }
+
+	void WriteRaw(const uint8_t *out, size_t amount) override;
+	void WriteRawAt(uint64_t pos, const uint8_t *out, size_t amount) override;
+	void Preallocate(uint64_t size) override;
+	uint64_t GetPos() override;
+	void Close() override;
+};
+
+/**
+ * Copy a number of raw bytes from a reader to a writer, without
+ * interpreting them in any way.
+ * @param reader the reader to copy from; copying starts at its current position
+ * @param writer the writer to copy to
+ * @param amount the amount of bytes to copy
+ */
+void CopyRaw(Reader &reader, Writer &writer, uint64_t amount);
+
 #endif /* IO_H */
@@ -0,0 +1,85 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file parallel.cpp Implementation of spreading work over multiple threads */
+
+#include "stdafx.h"
+#include "parallel.hpp"
+#include "io.hpp"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+unsigned int _threads = 0;
+
+unsigned int GetThreadCount()
+{
+	if (_threads != 0) return _threads;
+	return std::max(1U, std::thread::hardware_concurrency());
+}
+
+void ParallelFor(size_t count, const std::function<void(unsigned int thread, size_t index)> &func)
+{
+	std::atomic<size_t> next = 0;
+	std::atomic<bool> failed = false;
+	std::exception_ptr error;
+	std::mutex error_lock;
+
+	auto worker = [&](unsigned int thread) {
+		for (size_t index = next++; index < count && !failed; index = next++) {
+			try {
+				func(thread, index);
+			} catch (...) {
+				std::lock_guard<std::mutex> guard(error_lock);
+				if (!failed) error = std::current_exception();
+				failed = true;
+			}
+		}
+	};
+
+	unsigned int thread_count = (unsigned int)std::min<size_t>(GetThreadCount(), count);
+	std::vector<std::thread> threads;
+	for (unsigned int thread = 1; thread < thread_count; thread++) {
+		threads.emplace_back(worker, thread);
+	}
+	worker(0);
+
+	for (std::thread &thread : threads) thread.join();
+	if (error) std::rethrow_exception(error);
+}
+
+void ParallelRead(Reader &reader, size_t count, const std::function<void(Reader &cursor, size_t index)> &func)
+{
+	/* Every thread needs its own cursor, as they all read from different places. */
+	std::vector<std::unique_ptr<Reader>> cursors(GetThreadCount());
+	cursors[0] = reader.OpenCursor();
+	if (cursors[0] == nullptr) {
+		for (size_t index = 0; index < count; index++) func(reader, index);
+		return;
+	}
+
+	ParallelFor(count, [&](unsigned int thread, size_t index) {
+		if (cursors[thread] == nullptr) cursors[thread] = reader.OpenCursor();
+		func(*cursors[thread], index);
+	});
+}
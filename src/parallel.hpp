@@ -0,0 +1,61 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file parallel.hpp Interface for spreading work over multiple threads */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <functional>
+
+class Reader;
+
+/** Number of threads to spread work over; 0 means one thread per core. */
+extern unsigned int _threads;
+
+/**
+ * Get the number of threads work is spread over.
+ * @return the number of threads, at least 1
+ */
+unsigned int GetThreadCount();
+
+/**
+ * Call a function for every index from 0 up to count, spread over multiple
+ * threads. Every thread gets its own number, so it can keep its own state.
+ * When any call throws, no further calls are started and the first error
+ * is rethrown once all threads are done.
+ * @param count the number of indices
+ * @param func  the function to call with the number of the thread and the index
+ */
+void ParallelFor(size_t count, const std::function<void(unsigned int thread, size_t index)> &func);
+
+/**
+ * Call a function for every index from 0 up to count, spread over multiple
+ * threads like ParallelFor, with a cursor of a reader for every thread, so
+ * every call can read from its own place in the source. When the source
+ * can not be read concurrently, the function is called for every index in
+ * turn with the reader itself.
+ * @param reader the reader to open the cursors of
+ * @param count  the number of indices
+ * @param func   the function to call with the cursor of the thread and the index
+ */
+void ParallelRead(Reader &reader, size_t count, const std::function<void(Reader &cursor, size_t index)> &func);
+
+#endif /* PARALLEL_HPP */
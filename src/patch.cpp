@@ -0,0 +1,214 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file patch.cpp Implementation of patches between cat files
+ *
+ * A patch consists of a header followed by operations that, executed in
+ * order, write the new cat file from begin to end. Every operation either
+ * copies a block of the old cat file or contains the block itself, and has
+ * the hash of the block, so applying a patch to the wrong cat file is
+ * noticed. The header table of the new cat file and the entries that are
+ * not in the old cat file are contained in the patch; the other entries
+ * are copied from the old cat file.
+ */
+
+#include "stdafx.h"
+#include "patch.hpp"
+#include "catalogue.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+#include "schema.hpp"
+#include <map>
+
+/**
+ * The header of a patch file.
+ */
+struct PatchHeader {
+	using Magic    = FixedField<uint32_t,  0, FourCC("CATP")>; ///< Identifier of a patch file
+	using Version  = FixedField<uint32_t,  4, 1>;              ///< Version of the format of the patch
+	using NewSize  = Field<uint64_t,  8>;                      ///< Size of the cat file the patch results in
+	using NumOps   = Field<uint64_t, 16>;                      ///< Number of operations that follow
+
+	using Layout = Record<Magic, Version, NewSize, NumOps>;
+};
+
+/**
+ * An operation of a patch file. For a DATA operation the block follows the
+ * operation in the patch.
+ */
+struct PatchOp {
+	using Type   = Field<uint32_t,  0>; ///< Kind of operation; COPY or DATA
+	using Offset = Field<uint64_t,  4>; ///< Offset in the old cat file of the block, for COPY operations
+	using Length = Field<uint64_t, 12>; ///< Size of the block
+	using Hash   = Field<uint64_t, 20>; ///< Hash of the block
+
+	using Layout = Record<Type, Offset, Length, Hash>;
+
+	static constexpr uint32_t COPY = FourCC("COPY"); ///< Copy a block of the old cat file
+	static constexpr uint32_t DATA = FourCC("DATA"); ///< Write the block contained in the patch
+};
+
+/**
+ * Hash all entries of a cat file, spread over multiple threads.
+ * @param reader    the reader for the cat file
+ * @param catalogue the index of the cat file
+ * @return the hashes of the whole entries, in the order of the header table
+ */
+static std::vector<uint64_t> HashEntries(Reader &reader, const Catalogue &catalogue)
+{
+	const std::vector<CatEntry> &entries = catalogue.GetEntries();
+	std::vector<uint64_t> hashes(entries.size());
+
+	ParallelRead(reader, entries.size(), [&](Reader &entry_reader, size_t index) {
+		hashes[index] = HashPayload(entry_reader, entries[index].offset, entries[index].length);
+	});
+
+	return hashes;
+}
+
+/**
+ * Write an operation to a patch file.
+ * @param writer the patch file
+ * @param type   the kind of operation
+ * @param offset the offset in the old cat file of the block
+ * @param length the size of the block
+ * @param hash   the hash of the block
+ */
+static void WriteOp(Writer &writer, uint32_t type, uint64_t offset, uint64_t length, uint64_t hash)
+{
+	uint8_t buffer[PatchOp::Layout::size];
+	PatchOp::Type::Pack(buffer, type);
+	PatchOp::Offset::Pack(buffer, offset);
+	PatchOp::Length::Pack(buffer, length);
+	PatchOp::Hash::Pack(buffer, hash);
+	writer.WriteRaw(buffer, sizeof(buffer));
+}
+
+void MakePatch(const std::string &old_file, const std::string &new_file, const std::string &patch_file)
+{
+	std::unique_ptr<Reader> old_cat_reader = OpenCatReader(old_file);
+	Reader &old_reader = *old_cat_reader;
+	Catalogue old_cat(old_reader);
+	std::vector<uint64_t> old_hashes = HashEntries(old_reader, old_cat);
+
+	std::unique_ptr<Reader> new_cat_reader = OpenCatReader(new_file);
+	Reader &new_reader = *new_cat_reader;
+	Catalogue new_cat(new_reader);
+	std::vector<uint64_t> new_hashes = HashEntries(new_reader, new_cat);
+
+	const std::vector<CatEntry> &old_entries = old_cat.GetEntries();
+	const std::vector<CatEntry> &new_entries = new_cat.GetEntries();
+
+	/* Entries are the same when their hash and length are the same. */
+	std::map<std::pair<uint64_t, uint64_t>, const CatEntry *> old_blocks;
+	for (size_t i = 0; i < old_entries.size(); i++) {
+		old_blocks.emplace(std::make_pair(old_hashes[i], old_entries[i].length), &old_entries[i]);
+	}
+
+	/* The header table, and anything after the last entry, is always in the patch. */
+	uint64_t table_size = new_entries.empty() ? new_reader.GetSize() : new_entries.front().offset;
+	uint64_t end = new_entries.empty() ? new_reader.GetSize() : new_entries.back().offset + new_entries.back().length;
+	uint64_t trailer_size = new_reader.GetSize() - end;
+
+	FileWriter patch_writer(patch_file);
+
+	uint8_t header[PatchHeader::Layout::size];
+	PatchHeader::Layout::PackFixed(header);
+	PatchHeader::NewSize::Pack(header, new_reader.GetSize());
+	PatchHeader::NumOps::Pack(header, 1 + new_entries.size() + (trailer_size != 0 ? 1 : 0));
+	patch_writer.WriteRaw(header, sizeof(header));
+
+	WriteOp(patch_writer, PatchOp::DATA, 0, table_size, HashPayload(new_reader, 0, table_size));
+	new_reader.Seek(0);
+	CopyRaw(new_reader, patch_writer, table_size);
+
+	size_t copied = 0;
+	uint64_t contained = 0;
+	for (size_t i = 0; i < new_entries.size(); i++) {
+		const CatEntry &entry = new_entries[i];
+
+		auto found = old_blocks.find(std::make_pair(new_hashes[i], entry.length));
+		if (found != old_blocks.end()) {
+			WriteOp(patch_writer, PatchOp::COPY, found->second->offset, entry.length, new_hashes[i]);
+			copied++;
+			continue;
+		}
+
+		WriteOp(patch_writer, PatchOp::DATA, 0, entry.length, new_hashes[i]);
+		new_reader.Seek(entry.offset);
+		CopyRaw(new_reader, patch_writer, entry.length);
+		contained += entry.length;
+	}
+
+	if (trailer_size != 0) {
+		WriteOp(patch_writer, PatchOp::DATA, 0, trailer_size, HashPayload(new_reader, end, trailer_size));
+		new_reader.Seek(end);
+		CopyRaw(new_reader, patch_writer, trailer_size);
+	}
+
+	printf("%zu entries copied, %zu entries contained, %llu of %llu bytes in the patch\n", copied, new_entries.size() - copied,
+			(unsigned long long)(table_size + contained + trailer_size), (unsigned long long)new_reader.GetSize());
+
+	patch_writer.Close();
+}
+
+void ApplyPatch(const std::string &old_file, const std::string &patch_file, const std::string &new_file)
+{
+	std::unique_ptr<Reader> old_cat_reader = OpenCatReader(old_file);
+	Reader &old_reader = *old_cat_reader;
+	FileReader patch_reader(patch_file, true, AccessHint::Sequential);
+
+	uint8_t header[PatchHeader::Layout::size];
+	patch_reader.ReadRaw(header, sizeof(header));
+	if (!PatchHeader::Magic::Validate(header)) throw "Unexpected format; expected \"CATP\" in " + patch_file;
+	if (!PatchHeader::Version::Validate(header)) throw "Unsupported patch version in " + patch_file;
+
+	FileWriter new_writer(new_file);
+	uint64_t num_ops = PatchHeader::NumOps::Unpack(header);
+	for (uint64_t i = 0; i < num_ops; i++) {
+		uint8_t op[PatchOp::Layout::size];
+		patch_reader.ReadRaw(op, sizeof(op));
+
+		uint64_t length = PatchOp::Length::Unpack(op);
+		uint64_t hash;
+		switch (PatchOp::Type::Unpack(op)) {
+			case PatchOp::COPY: {
+				uint64_t offset = PatchOp::Offset::Unpack(op);
+				if (offset > old_reader.GetSize() || length > old_reader.GetSize() - offset) throw "Patch " + patch_file + " does not belong to " + old_file;
+
+				hash = HashPayload(old_reader, offset, length, &new_writer);
+				if (hash != PatchOp::Hash::Unpack(op)) throw "Patch " + patch_file + " does not belong to " + old_file;
+				break;
+			}
+
+			case PatchOp::DATA:
+				hash = HashPayload(patch_reader, patch_reader.GetPos(), length, &new_writer);
+				if (hash != PatchOp::Hash::Unpack(op)) throw "Corrupt data in " + patch_file;
+				break;
+
+			default:
+				throw "Unexpected operation in " + patch_file;
+		}
+	}
+
+	if (new_writer.GetPos() != PatchHeader::NewSize::Unpack(header)) throw "Corrupt data in " + patch_file;
+	new_writer.Close();
+}
@@ -0,0 +1,47 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file patch.hpp Interface for patches between cat files */
+
+#ifndef PATCH_HPP
+#define PATCH_HPP
+
+/**
+ * Make a patch that turns one cat file into another. The patch contains
+ * the header table of the new cat file, the entries that are not in the
+ * old cat file and, for the other entries, where to copy them from in the
+ * old cat file.
+ * @param old_file   the cat file the patch is applied to
+ * @param new_file   the cat file the patch results in
+ * @param patch_file the patch file to write
+ */
+void MakePatch(const std::string &old_file, const std::string &new_file, const std::string &patch_file);
+
+/**
+ * Apply a patch to a cat file. Everything that is copied from the old cat
+ * file and the patch is checked against the hashes in the patch, so a patch
+ * for another cat file is refused.
+ * @param old_file   the cat file to apply the patch to
+ * @param patch_file the patch file to apply
+ * @param new_file   the cat file to write
+ */
+void ApplyPatch(const std::string &old_file, const std::string &patch_file, const std::string &new_file);
+
+#endif /* PATCH_HPP */
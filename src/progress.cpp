@@ -0,0 +1,184 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file progress.cpp Implementation of reporting the progress of long running work */
+
+#include "stdafx.h"
+#include "progress.hpp"
+
+/** Time between two updates of the drawn progress */
+static const std::chrono::milliseconds REPORT_INTERVAL(250);
+
+/** Number of characters of the progress bar itself */
+static const int BAR_WIDTH = 20;
+
+/** Lock for writing to the console, so the progress and warnings are not mixed */
+static std::mutex _console_lock;
+
+/** The progress that is being drawn on the console, if any */
+static Progress *_drawn_progress = nullptr;
+
+/**
+ * Format an amount of bytes in a human readable way.
+ * @param buffer the buffer to format into
+ * @param size   the size of the buffer
+ * @param bytes  the amount of bytes
+ */
+static void FormatBytes(char *buffer, size_t size, double bytes)
+{
+	if (bytes < 1024) {
+		snprintf(buffer, size, "%.0f B", bytes);
+	} else if (bytes < 1024 * 1024) {
+		snprintf(buffer, size, "%.1f KiB", bytes / 1024);
+	} else {
+		snprintf(buffer, size, "%.1f MiB", bytes / (1024 * 1024));
+	}
+}
+
+/**
+ * Format a duration as hours, minutes and seconds.
+ * @param buffer  the buffer to format into
+ * @param size    the size of the buffer
+ * @param seconds the duration in seconds
+ */
+static void FormatTime(char *buffer, size_t size, double seconds)
+{
+	unsigned long total = (unsigned long)(seconds + 0.5);
+	if (total >= 3600) {
+		snprintf(buffer, size, "%lu:%02lu:%02lu", total / 3600, total / 60 % 60, total % 60);
+	} else {
+		snprintf(buffer, size, "%lu:%02lu", total / 60, total % 60);
+	}
+}
+
+Progress::Progress(bool show) : start(std::chrono::steady_clock::now())
+{
+	if (!show) return;
+
+	{
+		std::lock_guard<std::mutex> guard(_console_lock);
+		_drawn_progress = this;
+	}
+
+	this->reporter = std::thread([this]() {
+		std::unique_lock<std::mutex> guard(this->lock);
+		while (!this->stopped.wait_for(guard, REPORT_INTERVAL, [this]() { return this->stopping; })) {
+			guard.unlock();
+			this->Draw();
+			guard.lock();
+		}
+	});
+}
+
+Progress::~Progress()
+{
+	this->Finish();
+}
+
+void Progress::SetTotal(uint64_t samples, uint64_t bytes)
+{
+	this->bytes_total.store(bytes, std::memory_order_relaxed);
+	this->samples_total.store(samples, std::memory_order_relaxed);
+}
+
+void Progress::Finish()
+{
+	if (!this->reporter.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->stopping = true;
+	}
+	this->stopped.notify_one();
+	this->reporter.join();
+
+	this->Draw();
+
+	std::lock_guard<std::mutex> guard(_console_lock);
+	printf("\n");
+	if (_drawn_progress == this) _drawn_progress = nullptr;
+}
+
+void Progress::Draw()
+{
+	uint64_t samples = this->samples_done.load(std::memory_order_relaxed);
+	uint64_t bytes = this->bytes_done.load(std::memory_order_relaxed);
+	uint64_t samples_total = this->samples_total.load(std::memory_order_relaxed);
+	uint64_t bytes_total = this->bytes_total.load(std::memory_order_relaxed);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+
+	char line[160];
+	char amount[32];
+	char rate[32];
+	char eta[32];
+	size_t length = 0;
+
+	double fraction = 0;
+	if (samples_total != 0) {
+		fraction = bytes_total != 0 ? (double)bytes / bytes_total : (double)samples / samples_total;
+		fraction = std::min(fraction, 1.0);
+
+		int filled = (int)(fraction * BAR_WIDTH);
+		line[length++] = '[';
+		for (int i = 0; i < BAR_WIDTH; i++) line[length++] = i < filled ? '#' : ' ';
+		length += snprintf(line + length, sizeof(line) - length, "] %3d%% ", (int)(fraction * 100));
+	}
+
+	FormatBytes(amount, sizeof(amount), (double)bytes);
+	length += snprintf(line + length, sizeof(line) - length, "%llu samples, %s", (unsigned long long)samples, amount);
+
+	if (elapsed > 0) {
+		FormatBytes(rate, sizeof(rate), bytes / elapsed);
+		length += snprintf(line + length, sizeof(line) - length, ", %s/s, %.0f samples/s", rate, samples / elapsed);
+	}
+
+	if (fraction > 0 && fraction < 1) {
+		FormatTime(eta, sizeof(eta), elapsed * (1 - fraction) / fraction);
+		length += snprintf(line + length, sizeof(line) - length, ", ETA %s", eta);
+	}
+
+	/* Overwrite whatever was left of the previous, longer, progress. */
+	std::lock_guard<std::mutex> guard(_console_lock);
+	printf("\r%s%*s", line, (int)(this->drawn > length ? this->drawn - length : 0), "");
+	fflush(stdout);
+	this->drawn = length;
+}
+
+void Progress::Clear()
+{
+	if (this->drawn == 0) return;
+
+	printf("\r%*s\r", (int)this->drawn, "");
+	fflush(stdout);
+	this->drawn = 0;
+}
+
+void ShowWarning(const char *format, ...)
+{
+	std::lock_guard<std::mutex> guard(_console_lock);
+	if (_drawn_progress != nullptr) _drawn_progress->Clear();
+
+	va_list ap;
+	va_start(ap, format);
+	fprintf(stderr, "Warning: ");
+	vfprintf(stderr, format, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+}
@@ -0,0 +1,107 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file progress.hpp Interface for reporting the progress of long running work */
+
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * Progress of working through a number of samples. The work, which may be
+ * spread over multiple threads, only updates counters; a separate thread
+ * draws a progress bar with the throughput and the remaining time a few
+ * times per second, so the work is never held up by the console.
+ */
+class Progress {
+private:
+	std::atomic<uint64_t> samples_done = 0;  ///< Number of samples that are done
+	std::atomic<uint64_t> bytes_done = 0;    ///< Number of bytes of the samples that are done
+	std::atomic<uint64_t> samples_total = 0; ///< Number of samples to do; 0 when unknown
+	std::atomic<uint64_t> bytes_total = 0;   ///< Number of bytes of the samples to do; 0 when unknown
+
+	std::chrono::steady_clock::time_point start; ///< The moment the work started
+	std::mutex lock;                 ///< Lock for stopping the reporter
+	std::condition_variable stopped; ///< Signalled when the reporter has to stop
+	bool stopping = false;           ///< Whether the reporter has to stop
+	std::thread reporter;            ///< Thread that draws the progress, if any
+	size_t drawn = 0;                ///< Length of the last drawn progress
+
+	/**
+	 * Draw the current progress over the previously drawn progress.
+	 */
+	void Draw();
+
+	/**
+	 * Remove the drawn progress from the console; the next update draws it again.
+	 */
+	void Clear();
+
+	friend void ShowWarning(const char *format, ...);
+
+public:
+	/**
+	 * Start tracking the progress of some work.
+	 * @param show whether to draw the progress on the console
+	 */
+	Progress(bool show);
+
+	/**
+	 * Stop tracking the progress, finishing the drawn progress if needed.
+	 */
+	~Progress();
+
+	/**
+	 * Set the amount of work to do, so the remaining time can be estimated.
+	 * @param samples the number of samples
+	 * @param bytes   the number of bytes of the samples
+	 */
+	void SetTotal(uint64_t samples, uint64_t bytes);
+
+	/**
+	 * Mark a sample as done. May be called from any thread.
+	 * @param bytes the number of bytes of the sample
+	 */
+	inline void Done(uint64_t bytes)
+	{
+		this->bytes_done.fetch_add(bytes, std::memory_order_relaxed);
+		this->samples_done.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Stop drawing the progress, after drawing the final state.
+	 */
+	void Finish();
+};
+
+/**
+ * Show a warning on the console. Any progress that is being drawn is
+ * removed first, so the warning does not end up in the middle of it.
+ * @param format the format of the warning, without "Warning: " and the newline
+ * @param ... the data of the warning
+ */
+void ShowWarning(const char *format, ...);
+
+#endif /* PROGRESS_HPP */
@@ -0,0 +1,122 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file queue.hpp Queue for handing work from one thread to another */
+
+#ifndef QUEUE_HPP
+#define QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * Queue between a producing and a consuming thread, that limits the amount
+ * of bytes in flight. An item is in flight from the moment it is pushed
+ * until the consumer releases it, i.e. also while it is being consumed.
+ * @tparam T the type of the items
+ */
+template <typename T>
+class BoundedQueue {
+	std::mutex lock;                  ///< Lock for all of the state below
+	std::condition_variable changed;  ///< Signalled whenever the state changes
+	std::deque<std::pair<T, size_t>> items; ///< The queued items and their size
+	size_t budget;                    ///< Maximum amount of bytes in flight
+	size_t in_flight = 0;             ///< Amount of bytes in flight
+	bool closed = false;              ///< Whether the producer is done
+	bool aborted = false;             ///< Whether the consumer gave up
+
+public:
+	/**
+	 * Create a new queue.
+	 * @param budget the maximum amount of bytes in flight
+	 */
+	BoundedQueue(size_t budget) : budget(budget) {}
+
+	/**
+	 * Add an item to the queue, waiting until it fits in the budget. An
+	 * item that is larger than the whole budget is let through when nothing
+	 * else is in flight.
+	 * @param item the item to add
+	 * @param size the size of the item in bytes
+	 * @return false if the consumer gave up, so there is no use producing more
+	 */
+	bool Push(T &&item, size_t size)
+	{
+		std::unique_lock<std::mutex> guard(this->lock);
+		this->changed.wait(guard, [&]() { return this->aborted || this->in_flight == 0 || this->in_flight + size <= this->budget; });
+		if (this->aborted) return false;
+
+		this->in_flight += size;
+		this->items.emplace_back(std::move(item), size);
+		this->changed.notify_all();
+		return true;
+	}
+
+	/**
+	 * Take the next item from the queue, waiting until there is one. The
+	 * size of the item must be released once the consumer is done with it.
+	 * @return the item, or nothing when the producer is done
+	 */
+	std::optional<T> Pop()
+	{
+		std::unique_lock<std::mutex> guard(this->lock);
+		this->changed.wait(guard, [&]() { return this->aborted || this->closed || !this->items.empty(); });
+		if (this->aborted || this->items.empty()) return std::nullopt;
+
+		T item = std::move(this->items.front().first);
+		this->items.pop_front();
+		return item;
+	}
+
+	/**
+	 * Tell the queue the consumer is done with an item.
+	 * @param size the size of the item in bytes
+	 */
+	void Release(size_t size)
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->in_flight -= size;
+		this->changed.notify_all();
+	}
+
+	/**
+	 * Tell the queue that the producer will not add any more items.
+	 */
+	void Close()
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->closed = true;
+		this->changed.notify_all();
+	}
+
+	/**
+	 * Tell the queue that the consumer will not take any more items.
+	 */
+	void Abort()
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->aborted = true;
+		this->changed.notify_all();
+	}
+};
+
+#endif /* QUEUE_HPP */
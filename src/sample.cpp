@@ -46,117 +46,109 @@
 
 #include "stdafx.h"
 #include "sample.hpp"
+#include "schema.hpp"
+#include "audio.hpp"
 
 /** The size of the RIFF headers of a WAV file */
-static const uint32_t RIFF_HEADER_SIZE = 44;
+static const uint32_t RIFF_HEADER_SIZE = RiffHeader::Layout::size;
 
-/**
- * Read a string (byte length including termination, actual data) from a reader.
- * @param reader the reader to read from
- * @return the read string
- */
-static std::string ReadString(FileReader &reader)
+Sample::Sample(Reader &reader)
 {
-	uint8_t name_len = reader.ReadByte();
-	char buffer[256];
+	uint8_t buffer[CatHeaderEntry::Layout::size];
+	reader.ReadRaw(buffer, sizeof(buffer));
 
-	reader.ReadRaw((uint8_t *)buffer, name_len);
-	buffer[name_len - 1] = '\0';
-
-	return buffer;
+	this->offset = CatHeaderEntry::Offset::Unpack(buffer) & CatHeaderEntry::OFFSET_MASK;
+	this->size   = CatHeaderEntry::Size::Unpack(buffer);
 }
 
-/**
- * Write a string (byte length including termination, actual data) to a writer.
- * @param str    the string to write
- * @param writer the writer to write to
- */
-static void WriteString(const std::string &str, FileWriter &writer)
-{
-	uint8_t str_len = (uint8_t)(str.length() + 1);
-	writer.WriteByte(str_len);
-	writer.WriteRaw((const uint8_t *)str.c_str(), str_len);
-}
-
-
-Sample::Sample(FileReader &reader)
-{
-	this->offset = reader.ReadDword() & 0x7FFFFFFF;
-	this->size   = reader.ReadDword();
-}
-
-Sample::Sample(const std::string &filename, const std::string &name) :
+Sample::Sample(Reader &reader, const std::string &name, const std::string &filename) :
 	offset(0),
 	name(name),
 	filename(filename)
 {
-	FileReader sample_reader(filename);
-	if (!this->ReadSample(sample_reader, false)) {
+	if (!this->ReadSample(reader, false)) {
 		/* File was not WAV, treat as raw. */
-		this->size = static_cast<uint32_t>(sample_reader.GetSize());
+		if (reader.GetSize() > UINT32_MAX) throw "Sample too large in " + filename;
+		this->size = static_cast<uint32_t>(reader.GetSize());
 		this->sample_data.resize(this->size);
-		sample_reader.ReadRaw(this->sample_data.data(), this->sample_data.size());
+		reader.ReadRaw(this->sample_data.data(), this->sample_data.size());
 	}
 }
 
-bool Sample::ReadSample(FileReader &reader, bool check_size)
+bool Sample::ReadSampleHeader(Reader &reader, bool check_size)
 {
-	assert(this->sample_data.empty());
+	uint8_t header[RiffHeader::Layout::size];
 
-	uint32_t pos = reader.GetPos();
-	if (reader.ReadDword() != 'FFIR') {
+	uint64_t pos = reader.GetPos();
+	reader.ReadRaw(header, RiffHeader::ChunkId::size);
+	if (!RiffHeader::ChunkId::Validate(header)) {
 		reader.Seek(pos);
 		return false;
 	}
+	reader.ReadRaw(header + RiffHeader::ChunkId::size, sizeof(header) - RiffHeader::ChunkId::size);
+
+	if (!RiffHeader::Layout::Validate(header)) {
+		/* Figure out what is wrong, so we can tell the user. */
+		if (!RiffHeader::Format::Validate(header))      throw "Unexpected format; expected \"WAVE\" in " + reader.GetFilename();
+		if (!RiffHeader::FmtId::Validate(header))       throw "Unexpected format; expected \"fmt \" in " + reader.GetFilename();
+		if (!RiffHeader::FmtSize::Validate(header))     throw "Unexpected fmt chunk size in " + reader.GetFilename();
+		if (!RiffHeader::AudioFormat::Validate(header)) throw "Unexpected audio format; expected \"PCM\" in " + reader.GetFilename();
+		throw "Unexpected chunk; expected \"data\" in " + reader.GetFilename();
+	}
 
 	if (check_size) {
-		if (reader.ReadDword() + 8 != size) throw "Unexpected RIFF chunk size in " + reader.GetFilename();
+		if (RiffHeader::ChunkSize::Unpack(header) + 8ULL != size) throw "Unexpected RIFF chunk size in " + reader.GetFilename();
 	} else {
-		this->size = reader.ReadDword() + 8;
+		if (RiffHeader::ChunkSize::Unpack(header) > UINT32_MAX - 8) throw "Unexpected RIFF chunk size in " + reader.GetFilename();
+		this->size = RiffHeader::ChunkSize::Unpack(header) + 8;
 	}
-	if (reader.ReadDword() != 'EVAW') throw "Unexpected format; expected \"WAVE\" in " + reader.GetFilename();
-	if (reader.ReadDword() != ' tmf') throw "Unexpected format; expected \"fmt \" in " + reader.GetFilename();
-	if (reader.ReadDword() != 16    ) throw "Unexpected fmt chunk size in " + reader.GetFilename();
-	if (reader.ReadWord()  != 1     ) throw "Unexpected audio format; expected \"PCM\" in " + reader.GetFilename();
 
-	this->num_channels = reader.ReadWord();
+	this->num_channels = RiffHeader::NumChannels::Unpack(header);
 	if (this->num_channels != 1) throw "Unexpected number of audio channels; expected 1 in " + reader.GetFilename();
 
-	this->sample_rate = reader.ReadDword();
+	this->sample_rate = RiffHeader::SampleRate::Unpack(header);
 	if (this->sample_rate != 11025 && this->sample_rate != 22050 && this->sample_rate != 44100) throw "Unexpected same rate; expected 11025, 22050 or 44100 in " + reader.GetFilename();
 
-	/* Read these and validate them later on.
-	 * Saving them is unnecesary as they can be easily calucated. */
-	uint32_t byte_rate   = reader.ReadDword();
-	uint16_t block_align = reader.ReadWord();
-
-	this->bits_per_sample = reader.ReadWord();
+	this->bits_per_sample = RiffHeader::BitsPerSample::Unpack(header);
 	if (this->bits_per_sample != 8 && this->bits_per_sample != 16) throw "Unexpected number of bits per channel; expected 8 or 16 in " + reader.GetFilename();
 
-	if (byte_rate != this->sample_rate * this->num_channels * this->bits_per_sample / 8) throw "Unexpected byte rate in " + reader.GetFilename();
-	if (block_align != this->num_channels * this->bits_per_sample / 8) throw "Unexpected block align in " + reader.GetFilename();
-
-	if (reader.ReadDword() != 'atad') throw "Unexpected chunk; expected \"data\" in " + reader.GetFilename();
+	/* Byte rate and block align are not saved as they can be easily calculated. */
+	if (RiffHeader::ByteRate::Unpack(header) != this->sample_rate * this->num_channels * this->bits_per_sample / 8) throw "Unexpected byte rate in " + reader.GetFilename();
+	if (RiffHeader::BlockAlign::Unpack(header) != this->num_channels * this->bits_per_sample / 8) throw "Unexpected block align in " + reader.GetFilename();
 
 	/* Sometimes the files are padded, which causes them to start at the
 	 * wrong offset further on, so just read whatever amount of data was
 	 * specified in the top RIFF as long as sample size is within those
-	 * boundaries, i.e. within the RIFF. */
-	uint32_t sample_size = reader.ReadDword();
-	if (sample_size + RIFF_HEADER_SIZE > this->size) throw "Unexpected data chunk size in " + reader.GetFilename();
+	 * boundaries, i.e. within the RIFF. Whatever follows the data chunk
+	 * is kept as padding. */
+	uint32_t sample_size = RiffHeader::DataSize::Unpack(header);
+	if ((uint64_t)sample_size + RIFF_HEADER_SIZE > this->size) throw "Unexpected data chunk size in " + reader.GetFilename();
+	this->padding.resize(this->size - RIFF_HEADER_SIZE - sample_size);
+
+	return true;
+}
 
-	this->sample_data.resize(this->size - RIFF_HEADER_SIZE);
+bool Sample::ReadSample(Reader &reader, bool check_size)
+{
+	assert(this->sample_data.empty());
+
+	if (!this->ReadSampleHeader(reader, check_size)) return false;
+
+	this->sample_data.resize(this->size - RIFF_HEADER_SIZE - this->padding.size());
 	reader.ReadRaw(this->sample_data.data(), this->sample_data.size());
+	if (!this->padding.empty()) reader.ReadRaw(this->padding.data(), this->padding.size());
 	return true;
 }
 
-void Sample::ReadCatEntry(FileReader &reader, bool new_format, uint32_t index)
+template <bool NEW_FORMAT>
+void Sample::ReadCatEntry(Reader &reader, uint32_t index)
 {
 	assert(this->sample_data.empty());
 
 	if (reader.GetPos() != this->GetOffset()) throw "Invalid offset in file " + reader.GetFilename();
 
-	this->name = ReadString(reader);
+	/* Padding of the name aligns the data of the new format; the old format is not aligned. */
+	this->name = StringRecord::Read(reader, NEW_FORMAT ? &this->name_padding : nullptr);
 
 	bool is_raw = !this->ReadSample(reader);
 	if (is_raw) {
@@ -164,66 +156,158 @@ void Sample::ReadCatEntry(FileReader &reader, bool new_format, uint32_t index)
 		this->sample_data.resize(this->size);
 		reader.ReadRaw(this->sample_data.data(), this->sample_data.size());
 
-		if (!new_format) this->size += RIFF_HEADER_SIZE;
-	}
-
-	if (!new_format) {
-		/* The old format had sometimes the wrong values for e.g.
-		 * sample rate which made the playback too fast. */
-		this->num_channels    = 1;
-		this->sample_rate     = 11025;
-		this->bits_per_sample = 8;
+		if constexpr (!NEW_FORMAT) this->size += RIFF_HEADER_SIZE;
 	}
 
-	/* If name is 1 character then we're probably reading the DOS sample.cat, which does not contain filenames. */
-	if (!new_format && this->name.length() == 1) {
-		/* Construct a filename. */
-		this->filename = "wave" + std::to_string(index) + ".wav";
-	} else {
+	if constexpr (NEW_FORMAT) {
 		/* Some kind of data byte, unused */
 		reader.ReadByte();
 
-		this->filename = ReadString(reader);
+		this->filename = StringRecord::Read(reader);
+	} else {
+		this->FixOldFormat();
+		this->filename = ReadOldFormatFilename(reader, this->name, index);
 	}
 }
 
-void Sample::WriteSample(FileWriter &writer) const
+template void Sample::ReadCatEntry<false>(Reader &reader, uint32_t index);
+template void Sample::ReadCatEntry<true>(Reader &reader, uint32_t index);
+
+void Sample::FixOldFormat()
 {
-	if (this->num_channels == 0) {
-		/* No channels means this is a raw file and should be written as-is. */
-		writer.WriteRaw(this->sample_data.data(), this->sample_data.size());
-		return;
+	/* The old format had sometimes the wrong values for e.g.
+	 * sample rate which made the playback too fast. */
+	this->num_channels    = 1;
+	this->sample_rate     = 11025;
+	this->bits_per_sample = 8;
+}
+
+std::string Sample::ReadOldFormatFilename(Reader &reader, const std::string &name, uint32_t index)
+{
+	/* If name is 1 character then we're probably reading the DOS sample.cat, which does not contain filenames. */
+	if (name.length() == 1) {
+		/* Construct a filename. */
+		return "wave" + std::to_string(index) + ".wav";
 	}
 
-	writer.WriteDword('FFIR');
-	writer.WriteDword(this->size - 8);
-	writer.WriteDword('EVAW');
-
-	writer.WriteDword(' tmf');
-	writer.WriteDword(16);
-	writer.WriteWord(1);
-	writer.WriteWord(this->num_channels);
-	writer.WriteDword(this->sample_rate);
-	writer.WriteDword(this->sample_rate * this->num_channels * this->bits_per_sample / 8);
-	writer.WriteWord(this->num_channels * this->bits_per_sample / 8);
-	writer.WriteWord(this->bits_per_sample);
-
-	writer.WriteDword('atad');
-	writer.WriteDword(static_cast<uint32_t>(this->sample_data.size()));
+	/* Some kind of data byte, unused */
+	reader.ReadByte();
+
+	return StringRecord::Read(reader);
+}
+
+void Sample::UpgradeCatEntry(Reader &reader, Writer &writer, uint32_t index)
+{
+	assert(this->sample_data.empty());
+
+	if (reader.GetPos() != this->GetOffset()) throw "Invalid offset in file " + reader.GetFilename();
+
+	this->name = StringRecord::Read(reader);
+
+	/* The raw PCM sample gets the RIFF headers it was missing. */
+	if (!this->ReadSampleHeader(reader)) this->size += RIFF_HEADER_SIZE;
+	this->FixOldFormat();
+
+	std::vector<uint8_t> head = this->PackCatEntryHead();
+	writer.WriteRaw(head.data(), head.size());
+	CopyRaw(reader, writer, this->size - RIFF_HEADER_SIZE);
+
+	this->filename = ReadOldFormatFilename(reader, this->name, index);
+
+	/* The padding has been copied with the data already. */
+	std::vector<uint8_t> tail = this->PackCatEntryTail();
+	writer.WriteRaw(tail.data() + this->padding.size(), tail.size() - this->padding.size());
+}
+
+uint32_t Sample::TrimSilence(double silence_threshold)
+{
+	if (this->num_channels == 0) return 0;
+
+	auto [first, end] = FindAudibleFrames(this->sample_data.data(), this->sample_data.size(), this->bits_per_sample, silence_threshold);
+	if (first == end) return 0;
+
+	size_t bytes_per_frame = this->bits_per_sample / 8;
+	size_t old_size = this->sample_data.size();
+	this->sample_data.erase(this->sample_data.begin() + end * bytes_per_frame, this->sample_data.end());
+	this->sample_data.erase(this->sample_data.begin(), this->sample_data.begin() + first * bytes_per_frame);
+
+	/* The RIFF size follows the data, as the data is all there is after the headers. */
+	uint32_t removed = static_cast<uint32_t>(old_size - this->sample_data.size());
+	this->size -= removed;
+	return removed;
+}
+
+void Sample::WriteSample(Writer &writer) const
+{
+	if (this->num_channels != 0) {
+		uint8_t header[RiffHeader::Layout::size];
+		this->PackSampleHeader(header);
+		writer.WriteRaw(header, sizeof(header));
+	}
+	/* No channels means this is a raw file and the data is written as-is. */
 	writer.WriteRaw(this->sample_data.data(), this->sample_data.size());
+	if (!this->padding.empty()) writer.WriteRaw(this->padding.data(), this->padding.size());
 }
 
-void Sample::WriteCatEntry(FileWriter &writer) const
+void Sample::PackSampleHeader(uint8_t *header) const
 {
-	if (writer.GetPos() != this->GetOffset()) throw "Invalid offset when writing file " + writer.GetFilename();
+	RiffHeader::Layout::PackFixed(header);
+	RiffHeader::ChunkSize::Pack(header, this->size - 8);
+	RiffHeader::NumChannels::Pack(header, this->num_channels);
+	RiffHeader::SampleRate::Pack(header, this->sample_rate);
+	RiffHeader::ByteRate::Pack(header, this->sample_rate * this->num_channels * this->bits_per_sample / 8);
+	RiffHeader::BlockAlign::Pack(header, this->num_channels * this->bits_per_sample / 8);
+	RiffHeader::BitsPerSample::Pack(header, this->bits_per_sample);
+	RiffHeader::DataSize::Pack(header, this->size - RIFF_HEADER_SIZE - static_cast<uint32_t>(this->padding.size()));
+}
+
+uint32_t Sample::GetHeadSize() const
+{
+	return static_cast<uint32_t>(StringRecord::Size(this->name, this->name_padding) + (this->num_channels != 0 ? RIFF_HEADER_SIZE : 0));
+}
+
+std::vector<uint8_t> Sample::PackCatEntryHead() const
+{
+	std::vector<uint8_t> head(this->GetHeadSize());
+	size_t length = StringRecord::Pack(head.data(), this->name, this->name_padding);
+	if (this->num_channels != 0) this->PackSampleHeader(head.data() + length);
+	return head;
+}
 
-	WriteString(this->GetName(), writer);
-	this->WriteSample(writer);
+std::vector<uint8_t> Sample::PackCatEntryTail() const
+{
+	std::vector<uint8_t> tail(this->padding.size() + 1 + StringRecord::Size(this->filename));
+	std::copy(this->padding.begin(), this->padding.end(), tail.begin());
 
 	/* Some kind of separator byte */
-	writer.WriteByte(0);
+	tail[this->padding.size()] = 0;
 
-	WriteString(this->GetFilename(), writer);
+	StringRecord::Pack(tail.data() + this->padding.size() + 1, this->filename);
+	return tail;
+}
+
+void Sample::WriteCatEntry(Writer &writer) const
+{
+	if (writer.GetPos() != this->GetOffset()) throw "Invalid offset when writing file " + writer.GetFilename();
+
+	std::vector<uint8_t> head = this->PackCatEntryHead();
+	std::vector<uint8_t> tail = this->PackCatEntryTail();
+	writer.WriteRaw(head.data(), head.size());
+	writer.WriteRaw(this->sample_data.data(), this->sample_data.size());
+	writer.WriteRaw(tail.data(), tail.size());
+}
+
+void Sample::WriteCatEntryAt(Writer &writer) const
+{
+	std::vector<uint8_t> head = this->PackCatEntryHead();
+	std::vector<uint8_t> tail = this->PackCatEntryTail();
+
+	uint64_t pos = this->GetOffset();
+	writer.WriteRawAt(pos, head.data(), head.size());
+	pos += head.size();
+	writer.WriteRawAt(pos, this->sample_data.data(), this->sample_data.size());
+	pos += this->sample_data.size();
+	writer.WriteRawAt(pos, tail.data(), tail.size());
 }
 
 const std::string &Sample::GetName() const
@@ -236,23 +320,48 @@ const std::string &Sample::GetFilename() const
 	return this->filename;
 }
 
-void Sample::SetOffset(uint32_t offset)
+void Sample::SetOffset(uint64_t offset)
+{
+	if (!CatHeaderEntry::IsValidOffset(offset)) throw "Sample " + this->name + " does not fit in the cat file; the cat format is limited to offsets below 2 GiB";
+	this->offset = static_cast<uint32_t>(offset);
+}
+
+uint64_t Sample::GetDataOffset() const
+{
+	return (uint64_t)this->offset + this->GetHeadSize();
+}
+
+bool Sample::SetPadding(uint32_t amount)
 {
-	assert(this->offset == 0);
-	this->offset = offset;
+	if (this->num_channels == 0) return amount == 0;
+	if (amount > UINT32_MAX - (this->size - this->padding.size())) return false;
+
+	this->size -= static_cast<uint32_t>(this->padding.size());
+	this->size += amount;
+	this->padding.assign(amount, this->bits_per_sample == 8 ? 0x80 : 0x00);
+	return true;
+}
+
+uint8_t Sample::GetNamePadding() const
+{
+	return this->name_padding;
+}
+
+bool Sample::SetNamePadding(uint32_t amount)
+{
+	if (StringRecord::Size(this->name, amount) - 1 > StringRecord::MAX_LENGTH) return false;
+
+	this->name_padding = static_cast<uint8_t>(amount);
+	return true;
 }
 
-uint32_t Sample::GetNextOffset() const
+uint64_t Sample::GetNextOffset() const
 {
-	return static_cast<uint32_t>(
-			this->offset +
-			1 +                            // length of the name
-			(this->name.length() + 1) +    // the name + '\0'
-			this->size +                   // size of the data
-			1 +                            // the delimiter
-			1 +                            // length of the filename
-			(this->filename.length() + 1)  // the filename + '\0'
-	);
+	return static_cast<uint64_t>(this->offset) +
+			StringRecord::Size(this->name, this->name_padding) + // the name
+			this->size +                        // size of the data
+			1 +                                 // the delimiter
+			StringRecord::Size(this->filename); // the filename
 }
 
 uint32_t Sample::GetOffset() const
@@ -264,3 +373,23 @@ uint32_t Sample::GetSize() const
 {
 	return this->size;
 }
+
+uint32_t Sample::GetSampleRate() const
+{
+	return this->sample_rate;
+}
+
+uint16_t Sample::GetNumChannels() const
+{
+	return this->num_channels;
+}
+
+uint16_t Sample::GetBitsPerSample() const
+{
+	return this->bits_per_sample;
+}
+
+const std::vector<uint8_t> &Sample::GetSampleData() const
+{
+	return this->sample_data;
+}
@@ -35,6 +35,7 @@ private:
 	uint32_t size = 0; ///< The size of the WAV RIFF, i.e. excluding name and filename
 
 	std::string name; ///< The name of the sample
+	uint8_t name_padding = 0; ///< Number of bytes of padding after the name in the cat entry
 	std::string filename; ///< The filename of the sample
 
 	uint32_t sample_rate = 0; ///< Sample rate; either 11025, 22050 or 44100
@@ -42,6 +43,43 @@ private:
 	uint16_t bits_per_sample = 0; ///< Number of bits per sample; either 8 or 16
 
 	std::vector<uint8_t> sample_data; ///< The actual raw sample data
+	std::vector<uint8_t> padding; ///< Whatever follows the data chunk within the RIFF
+
+	/**
+	 * Reads the RIFF headers of a sample from a reader, leaving the reader
+	 * at the begin of the sample data.
+	 * This function has some very strict tests on validity of the input file.
+	 * @param reader     place to read the headers from
+	 * @param check_size whether to check that our size makes sense with the size from the sample
+	 * @return true if the headers were read; false if the data is not a WAV file.
+	 */
+	bool ReadSampleHeader(Reader &reader, bool check_size = true);
+
+	/**
+	 * Apply the fixes for the wrong values that are in the old format.
+	 */
+	void FixOldFormat();
+
+
+	/**
+	 * Pack the RIFF headers of the sample.
+	 * @param header the buffer to pack the headers into; must be RiffHeader::Layout::size bytes
+	 */
+	void PackSampleHeader(uint8_t *header) const;
+
+	/**
+	 * Pack the part of the cat entry before the sample data, i.e. the name
+	 * and the RIFF headers.
+	 * @return the packed bytes
+	 */
+	std::vector<uint8_t> PackCatEntryHead() const;
+
+	/**
+	 * Pack the part of the cat entry after the sample data, i.e. the
+	 * padding, the separator and the filename.
+	 * @return the packed bytes
+	 */
+	std::vector<uint8_t> PackCatEntryTail() const;
 
 public:
 	/**
@@ -50,14 +88,15 @@ public:
 	 * read the offset and size from the file.
 	 * @param reader the file to read from
 	 */
-	Sample(FileReader &reader);
+	Sample(Reader &reader);
 
 	/**
 	 * Creates a new sample by reading the sample from a given (wav) file.
-	 * @param filename the file to read the sample from
+	 * @param reader   the file to read the sample from
 	 * @param name     the name of the sample
+	 * @param filename the filename of the sample, as stored in the cat entry
 	 */
-	Sample(const std::string &filename, const std::string &name);
+	Sample(Reader &reader, const std::string &name, const std::string &filename);
 
 	/**
 	 * Reads a sample from a reader.
@@ -67,29 +106,67 @@ public:
 	 * @param check_size whether to check that our size makes sense with the size from the sample
 	 * @return true if the sample was read.
 	 */
-	bool ReadSample(FileReader &reader, bool check_size = true);
+	bool ReadSample(Reader &reader, bool check_size = true);
+
+	/**
+	 * Reads the filename of a cat entry in the old format, or constructs
+	 * it when the entry does not have one.
+	 * @param reader place to read the filename from, right after the payload
+	 * @param name   the name of the sample
+	 * @param index  index of sample in cat header
+	 * @return the filename
+	 */
+	static std::string ReadOldFormatFilename(Reader &reader, const std::string &name, uint32_t index);
 
 	/**
 	 * Reads a cat entry from a reader.
 	 * This function has some very strict tests on validity of the input file.
+	 * @tparam NEW_FORMAT whether this is the old or new format; there are different strictness tests for both cases
 	 * @param reader place to read the cat entry from
-	 * @param new_format whether this is the old or new format; there are different strictness tests for both cases
 	 * @param index index of sample in cat header
 	 */
-	void ReadCatEntry(FileReader &reader, bool new_format, uint32_t index);
+	template <bool NEW_FORMAT>
+	void ReadCatEntry(Reader &reader, uint32_t index);
+
+	/**
+	 * Copy a cat entry in the old format from a reader to a writer as cat
+	 * entry in the new format, with the same fixes as reading the entry
+	 * applied. Only the headers are rewritten; the sample data is copied
+	 * without keeping it in memory.
+	 * @param reader place to read the old cat entry from
+	 * @param writer place to write the new cat entry to
+	 * @param index  index of sample in cat header
+	 */
+	void UpgradeCatEntry(Reader &reader, Writer &writer, uint32_t index);
+
+	/**
+	 * Remove the leading and trailing silence from the sample. Raw samples
+	 * and samples that are completely silent are left alone.
+	 * @param silence_threshold the level in dBFS below which the audio is silent
+	 * @return the amount of bytes removed
+	 */
+	uint32_t TrimSilence(double silence_threshold);
 
 	/**
 	 * Write a sample to a writer. If only a sample is written to the
 	 * file it would be a valid WAV file.
 	 * @param writer place to write the sample to
 	 */
-	void WriteSample(FileWriter &writer) const;
+	void WriteSample(Writer &writer) const;
 
 	/**
 	 * Write a cat entry to a writer.
 	 * @param writer place to write the cat entry to
 	 */
-	void WriteCatEntry(FileWriter &writer) const;
+	void WriteCatEntry(Writer &writer) const;
+
+	/**
+	 * Write a cat entry to a writer at the offset of the entry, without
+	 * using the current position of the writer. Multiple cat entries can
+	 * be written at the same time this way.
+	 * @param writer place to write the cat entry to; must be large enough already
+	 */
+	void WriteCatEntryAt(Writer &writer) const;
 
 
 	/**
@@ -108,14 +185,48 @@ public:
 	/**
 	 * Set the offset from the begin of the cat to this cat entry.
 	 * @param offset the offset.
+	 * @throw std::string when the offset is too large for the cat format
+	 */
+	void SetOffset(uint64_t offset);
+
+	/**
+	 * Get the size of the part of the cat entry before the sample data.
+	 * @return the size of the name and the RIFF headers
 	 */
-	void SetOffset(uint32_t offset);
+	uint32_t GetHeadSize() const;
+
+	/**
+	 * Get the offset from the begin of the cat to the sample data of this cat entry.
+	 * @return the offset of the sample data
+	 */
+	uint64_t GetDataOffset() const;
+
+	/**
+	 * Pad the RIFF of the sample after the data chunk with silence,
+	 * replacing any existing padding. Raw samples can not be padded.
+	 * @param amount the number of bytes of padding
+	 * @return false if the sample could not be padded
+	 */
+	bool SetPadding(uint32_t amount);
+
+	/**
+	 * Get the amount of padding after the terminator of the name in the cat entry.
+	 * @return the number of bytes of padding
+	 */
+	uint8_t GetNamePadding() const;
+
+	/**
+	 * Pad the name of the sample in the cat entry after its terminator.
+	 * @param amount the number of bytes of padding
+	 * @return false if the name record would become too long
+	 */
+	bool SetNamePadding(uint32_t amount);
 
 	/**
 	 * Get the offset for the cat entry that follows us.
 	 * @return the offset for the next cat entry
 	 */
-	uint32_t GetNextOffset() const;
+	uint64_t GetNextOffset() const;
 
 	/**
 	 * Get the offset from the begin of the cat to this cat entry.
@@ -129,6 +240,31 @@ public:
 	 * @return the size
 	 */
 	uint32_t GetSize() const;
+
+
+	/**
+	 * Get the sample rate of the sample.
+	 * @return the sample rate
+	 */
+	uint32_t GetSampleRate() const;
+
+	/**
+	 * Get the number of channels of the sample.
+	 * @return the number of channels; 0 for raw samples
+	 */
+	uint16_t GetNumChannels() const;
+
+	/**
+	 * Get the number of bits per sample of the sample.
+	 * @return the number of bits per sample
+	 */
+	uint16_t GetBitsPerSample() const;
+
+	/**
+	 * Get the raw PCM data of the sample.
+	 * @return the data
+	 */
+	const std::vector<uint8_t> &GetSampleData() const;
 };
 
 /** Lets have us a vector of samples */
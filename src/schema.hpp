@@ -0,0 +1,261 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file schema.hpp Compile-time descriptions of the binary records in cat and WAV files
+ *
+ * Each fixed size record is described once as a list of fields with their
+ * offsets. Reading a record is done by reading the whole record at once
+ * and unpacking the fields from the buffer; writing is done by packing the
+ * fields into a buffer and writing that at once. Both directions use the
+ * same description, so they cannot drift apart.
+ */
+
+#ifndef SCHEMA_HPP
+#define SCHEMA_HPP
+
+#include <utility>
+#include "io.hpp"
+
+/**
+ * Get the value of a four character code, as it is read as a little endian dword.
+ * @param code the four characters
+ * @return the value of the code
+ */
+constexpr uint32_t FourCC(const char (&code)[5])
+{
+	return (uint32_t)(uint8_t)code[0] | (uint32_t)(uint8_t)code[1] << 8 | (uint32_t)(uint8_t)code[2] << 16 | (uint32_t)(uint8_t)code[3] << 24;
+}
+
+/**
+ * A little endian field with a fixed offset within a record.
+ * @tparam T      the type of the field
+ * @tparam OFFSET the offset of the field from the begin of the record
+ */
+template <typename T, size_t OFFSET>
+struct Field {
+	static constexpr size_t offset = OFFSET;  ///< Offset of the field from the begin of the record
+	static constexpr size_t size = sizeof(T); ///< Size of the field in bytes
+
+	/**
+	 * Get the value of this field from a record.
+	 * @param buffer the record
+	 * @return the value
+	 */
+	static constexpr T Unpack(const uint8_t *buffer)
+	{
+		T value = 0;
+		for (size_t i = 0; i < sizeof(T); i++) value |= (T)buffer[OFFSET + i] << (8 * i);
+		return value;
+	}
+
+	/**
+	 * Set the value of this field in a record.
+	 * @param buffer the record
+	 * @param value  the value
+	 */
+	static constexpr void Pack(uint8_t *buffer, T value)
+	{
+		for (size_t i = 0; i < sizeof(T); i++) buffer[OFFSET + i] = (uint8_t)(value >> (8 * i));
+	}
+
+	/**
+	 * Set the value of this field when it has a fixed value; it has not.
+	 */
+	static constexpr void PackFixed(uint8_t *) {}
+
+	/**
+	 * Check the value of this field when it has a fixed value; it has not.
+	 * @return always true
+	 */
+	static constexpr bool Validate(const uint8_t *) { return true; }
+};
+
+/**
+ * A field with a fixed value, e.g. a chunk identifier.
+ * @tparam T      the type of the field
+ * @tparam OFFSET the offset of the field from the begin of the record
+ * @tparam VALUE  the value the field must have
+ */
+template <typename T, size_t OFFSET, T VALUE>
+struct FixedField : Field<T, OFFSET> {
+	static constexpr T value = VALUE; ///< The value the field must have
+
+	/**
+	 * Set the fixed value of this field in a record.
+	 * @param buffer the record
+	 */
+	static constexpr void PackFixed(uint8_t *buffer) { Field<T, OFFSET>::Pack(buffer, VALUE); }
+
+	/**
+	 * Check whether this field has its fixed value in a record.
+	 * @param buffer the record
+	 * @return true if the value is the fixed value
+	 */
+	static constexpr bool Validate(const uint8_t *buffer) { return Field<T, OFFSET>::Unpack(buffer) == VALUE; }
+};
+
+/**
+ * A record consisting of fields that follow each other without any gaps.
+ * @tparam Fields the fields, in order of their offset
+ */
+template <typename... Fields>
+struct Record {
+	static constexpr size_t size = (Fields::size + ...); ///< Size of the record in bytes
+
+	/**
+	 * Check whether every field starts where the previous field ends.
+	 * @return true if the fields are contiguous
+	 */
+	static constexpr bool IsContiguous()
+	{
+		size_t expected = 0;
+		for (auto [offset, size] : { std::pair<size_t, size_t>{ Fields::offset, Fields::size }... }) {
+			if (offset != expected) return false;
+			expected += size;
+		}
+		return true;
+	}
+	static_assert(IsContiguous(), "Fields of a record must be contiguous and in order");
+
+	/**
+	 * Set all fields with a fixed value in a record.
+	 * @param buffer the record
+	 */
+	static constexpr void PackFixed(uint8_t *buffer) { (Fields::PackFixed(buffer), ...); }
+
+	/**
+	 * Check all fields with a fixed value in a record in one go.
+	 * @param buffer the record
+	 * @return true if all fixed fields have their value
+	 */
+	static constexpr bool Validate(const uint8_t *buffer) { return (Fields::Validate(buffer) & ...); }
+};
+
+/**
+ * An entry in the header table at the begin of a cat file.
+ */
+struct CatHeaderEntry {
+	using Offset = Field<uint32_t, 0>; ///< Offset from the begin of the cat to the entry, and the format flag
+	using Size   = Field<uint32_t, 4>; ///< The size of the WAV RIFF of the entry
+
+	using Layout = Record<Offset, Size>;
+
+	static constexpr uint32_t NEW_FORMAT  = 1U << 31;   ///< Flag in the offset that marks the new format
+	static constexpr uint32_t OFFSET_MASK = 0x7FFFFFFF; ///< Mask for the actual offset
+
+	/**
+	 * Check whether an entry can start at the given offset, as the offset
+	 * has to fit in the 31 bits next to the format flag.
+	 * @param offset the offset from the begin of the cat
+	 * @return true if the offset can be stored
+	 */
+	static constexpr bool IsValidOffset(uint64_t offset) { return offset <= OFFSET_MASK; }
+};
+
+/**
+ * The RIFF headers of a PCM WAV file, up to and including the size of the data chunk.
+ */
+struct RiffHeader {
+	using ChunkId       = FixedField<uint32_t,  0, FourCC("RIFF")>; ///< Identifier of the RIFF chunk
+	using ChunkSize     = Field<uint32_t,  4>;                      ///< Number of bytes following in the RIFF chunk
+	using Format        = FixedField<uint32_t,  8, FourCC("WAVE")>; ///< Format of the RIFF chunk
+	using FmtId         = FixedField<uint32_t, 12, FourCC("fmt ")>; ///< Identifier of the format chunk
+	using FmtSize       = FixedField<uint32_t, 16, 16>;             ///< Size of the format chunk
+	using AudioFormat   = FixedField<uint16_t, 20, 1>;              ///< Audio format, PCM
+	using NumChannels   = Field<uint16_t, 22>;                      ///< Number of channels
+	using SampleRate    = Field<uint32_t, 24>;                      ///< Sample rate
+	using ByteRate      = Field<uint32_t, 28>;                      ///< Byte rate
+	using BlockAlign    = Field<uint16_t, 32>;                      ///< Block alignment
+	using BitsPerSample = Field<uint16_t, 34>;                      ///< Number of bits per sample
+	using DataId        = FixedField<uint32_t, 36, FourCC("data")>; ///< Identifier of the data chunk
+	using DataSize      = Field<uint32_t, 40>;                      ///< Number of bytes in the data chunk
+
+	using Layout = Record<ChunkId, ChunkSize, Format, FmtId, FmtSize, AudioFormat, NumChannels, SampleRate, ByteRate, BlockAlign, BitsPerSample, DataId, DataSize>;
+};
+static_assert(RiffHeader::Layout::size == 44, "The RIFF headers of a WAV file are 44 bytes");
+
+/**
+ * A string with a prefixed byte with its length, including the terminator.
+ */
+struct StringRecord {
+	/** Maximum number of bytes after the length, i.e. the string, the terminator and any padding. */
+	static constexpr size_t MAX_LENGTH = 255;
+
+	/**
+	 * Get the size of the record for a string.
+	 * @param str     the string
+	 * @param padding the number of bytes of padding after the terminator
+	 * @return the size in bytes
+	 */
+	static size_t Size(const std::string &str, size_t padding = 0) { return 1 + str.length() + 1 + padding; }
+
+	/**
+	 * Read a string record from a reader. Anything after the terminator is
+	 * padding, of which only the size is kept.
+	 * @param reader  the reader to read from
+	 * @param padding where to put the number of bytes of padding after the terminator, if anywhere
+	 * @return the read string
+	 */
+	static std::string Read(Reader &reader, uint8_t *padding = nullptr)
+	{
+		uint8_t length = reader.ReadByte();
+		if (length == 0) throw "Unexpected empty string in " + reader.GetFilename();
+
+		char buffer[256];
+		reader.ReadRaw((uint8_t *)buffer, length);
+		buffer[length - 1] = '\0';
+
+		std::string str = buffer;
+		if (padding != nullptr) *padding = static_cast<uint8_t>(length - 1 - str.length());
+		return str;
+	}
+
+	/**
+	 * Pack a string record into a buffer.
+	 * @param buffer  the buffer to pack into; must be at least Size(str, padding) bytes
+	 * @param str     the string to pack
+	 * @param padding the number of bytes of padding after the terminator; at most MAX_LENGTH bytes in total with the string and the terminator
+	 * @return the size of the record in bytes
+	 */
+	static size_t Pack(uint8_t *buffer, const std::string &str, size_t padding = 0)
+	{
+		assert(str.length() + 1 + padding <= MAX_LENGTH);
+
+		uint8_t length = (uint8_t)(str.length() + 1 + padding);
+		buffer[0] = length;
+		memcpy(buffer + 1, str.c_str(), str.length() + 1);
+		memset(buffer + 1 + str.length() + 1, 0, padding);
+		return 1 + length;
+	}
+
+	/**
+	 * Write a string record to a writer.
+	 * @param writer the writer to write to
+	 * @param str    the string to write; must be shorter than 255 characters
+	 */
+	static void Write(Writer &writer, const std::string &str)
+	{
+		uint8_t buffer[1 + 256];
+		writer.WriteRaw(buffer, Pack(buffer, str));
+	}
+};
+
+#endif /* SCHEMA_HPP */
@@ -31,12 +31,15 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <algorithm>
 #include <string>
 
 #if defined(_MSC_VER)
 	#define UNUSED
 
 	#define fileno _fileno
+	#define fseeko _fseeki64
+	#define ftello _ftelli64
 	#pragma warning(disable: 4996)   // 'strdup' was declared deprecated
 #elif defined(__GNUC__)
 	#include <stdint.h>
@@ -51,6 +54,11 @@
 	#include <io.h>
 	#define isatty _isatty
 	#define unlink _unlink
+
+	#if defined(__MINGW32__)
+		#define fseeko fseeko64
+		#define ftello ftello64
+	#endif
 #else
 	#include <unistd.h>
 #endif
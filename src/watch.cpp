@@ -0,0 +1,114 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file watch.cpp Implementation of watching files for changes */
+
+#include "stdafx.h"
+#include "watch.hpp"
+
+#if defined(__linux__)
+
+#include <poll.h>
+#include <sys/inotify.h>
+
+/** Time in milliseconds to wait for more changes after the first change. */
+static const int SETTLE_TIME = 50;
+
+FileWatcher::FileWatcher()
+{
+	this->fd = inotify_init1(IN_CLOEXEC);
+	if (this->fd < 0) throw std::string("Could not start watching files (") + strerror(errno) + ")";
+}
+
+FileWatcher::~FileWatcher()
+{
+	close(this->fd);
+}
+
+void FileWatcher::Watch(const std::string &filename)
+{
+	size_t separator = filename.rfind('/');
+	std::string directory = separator == std::string::npos ? "." : filename.substr(0, separator + 1);
+	std::string name = separator == std::string::npos ? filename : filename.substr(separator + 1);
+
+	/* Watching the same directory again yields the same handle. */
+	int wd = inotify_add_watch(this->fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0) throw "Could not watch " + filename + " (" + strerror(errno) + ")";
+
+	this->files[{wd, name}] = filename;
+}
+
+std::set<std::string> FileWatcher::WaitForChanges()
+{
+	std::set<std::string> changed;
+	alignas(struct inotify_event) char buffer[4096];
+
+	/* Block until the first change, then keep collecting until things settle down. */
+	int timeout = -1;
+	for (;;) {
+		struct pollfd pfd = { this->fd, POLLIN, 0 };
+		int ret = poll(&pfd, 1, timeout);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret < 0) throw std::string("Waiting for changes failed (") + strerror(errno) + ")";
+		if (ret == 0) {
+			if (!changed.empty()) return changed;
+			timeout = -1;
+			continue;
+		}
+
+		ssize_t len = read(this->fd, buffer, sizeof(buffer));
+		if (len < 0 && errno == EINTR) continue;
+		if (len < 0) throw std::string("Waiting for changes failed (") + strerror(errno) + ")";
+
+		for (char *ptr = buffer; ptr < buffer + len; ) {
+			const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(ptr);
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			if (event->len == 0) continue;
+
+			auto file = this->files.find({event->wd, event->name});
+			if (file != this->files.end()) changed.insert(file->second);
+		}
+
+		timeout = SETTLE_TIME;
+	}
+}
+
+#else
+
+FileWatcher::FileWatcher() : fd(-1)
+{
+	throw std::string("Watching files is not supported on this platform");
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+void FileWatcher::Watch(const std::string &)
+{
+}
+
+std::set<std::string> FileWatcher::WaitForChanges()
+{
+	return {};
+}
+
+#endif /* __linux__ */
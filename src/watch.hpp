@@ -0,0 +1,64 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file watch.hpp Interface for watching files for changes */
+
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+#include <map>
+#include <set>
+
+/**
+ * Simple class to wait for changes to a set of files.
+ * The directories of the files are watched instead of the files themselves,
+ * so files that are replaced instead of rewritten, as many editors do, are
+ * noticed as well.
+ */
+class FileWatcher {
+	int fd; ///< The handle of the watch instance
+	std::map<std::pair<int, std::string>, std::string> files; ///< The watched files, by handle of their directory and their name in it
+
+public:
+	/**
+	 * Create a new watcher that does not watch anything yet.
+	 */
+	FileWatcher();
+
+	/**
+	 * Cleans up our mess
+	 */
+	~FileWatcher();
+
+	/**
+	 * Start watching the given file. Watching a file more than once is allowed.
+	 * @param filename the file to watch
+	 */
+	void Watch(const std::string &filename);
+
+	/**
+	 * Wait until one or more of the watched files have been changed.
+	 * Changes made in quick succession are returned at once.
+	 * @return the changed files, with the filenames as passed to Watch
+	 */
+	std::set<std::string> WaitForChanges();
+};
+
+#endif /* WATCH_HPP */
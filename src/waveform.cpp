@@ -0,0 +1,210 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file waveform.cpp Implementation of the waveform overviews of cat files
+ *
+ * A waveform file consists of a header followed by an entry for every
+ * sample, in the order of the header table of the cat file. Every entry
+ * starts with the hash of the payload, i.e. the WAV RIFF, of the sample it
+ * belongs to, so a stale entry is easily recognised. Then follow the levels
+ * of the overview, from the most to the least detailed, each with the
+ * lowest and highest level of every bin as signed bytes.
+ */
+
+#include "stdafx.h"
+#include "waveform.hpp"
+#include "audio.hpp"
+#include "catalogue.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+#include "schema.hpp"
+#include <map>
+#include <memory>
+
+/**
+ * The header of a waveform file.
+ */
+struct WaveformHeader {
+	using Magic      = FixedField<uint32_t, 0, FourCC("CATW")>; ///< Identifier of a waveform file
+	using Version    = FixedField<uint32_t, 4, 1>;              ///< Version of the format of the waveform file
+	using NumEntries = Field<uint32_t, 8>;                      ///< Number of entries that follow
+
+	using Layout = Record<Magic, Version, NumEntries>;
+};
+
+/**
+ * The begin of an entry of a waveform file.
+ */
+struct WaveformEntry {
+	using Hash      = Field<uint64_t,  0>; ///< Hash of the payload of the sample
+	using Frames    = Field<uint64_t,  8>; ///< Number of frames of the sample
+	using NumLevels = Field<uint32_t, 16>; ///< Number of levels that follow
+
+	using Layout = Record<Hash, Frames, NumLevels>;
+};
+
+/**
+ * The begin of a level of a waveform file. The bins follow as pairs of
+ * the lowest and the highest level.
+ */
+struct WaveformLevelHeader {
+	using FramesPerBin = Field<uint32_t, 0>; ///< Number of frames in every bin
+	using NumBins      = Field<uint32_t, 4>; ///< Number of bins that follow
+
+	using Layout = Record<FramesPerBin, NumBins>;
+};
+
+/**
+ * The waveform overview of a single sample.
+ */
+struct Waveform {
+	uint64_t hash = 0;                 ///< Hash of the payload of the sample
+	uint64_t frames = 0;               ///< Number of frames of the sample
+	std::vector<WaveformLevel> levels; ///< The levels, from the most to the least detailed
+};
+
+/**
+ * Read the waveform overviews from a waveform file.
+ * @param reader the waveform file
+ * @return the overviews by the hash of their payload
+ */
+static std::map<uint64_t, Waveform> ReadWaveforms(Reader &reader)
+{
+	uint8_t header[WaveformHeader::Layout::size];
+	reader.ReadRaw(header, sizeof(header));
+	if (!WaveformHeader::Magic::Validate(header)) throw "Unexpected format; expected \"CATW\" in " + reader.GetFilename();
+	if (!WaveformHeader::Version::Validate(header)) throw "Unsupported waveform file version in " + reader.GetFilename();
+
+	std::map<uint64_t, Waveform> waveforms;
+	for (uint32_t i = WaveformHeader::NumEntries::Unpack(header); i > 0; i--) {
+		uint8_t entry[WaveformEntry::Layout::size];
+		reader.ReadRaw(entry, sizeof(entry));
+
+		Waveform waveform;
+		waveform.hash = WaveformEntry::Hash::Unpack(entry);
+		waveform.frames = WaveformEntry::Frames::Unpack(entry);
+
+		/* Bound the counts by what is left of the file, so a corrupt file does not make us allocate absurd amounts of memory. */
+		uint32_t num_levels = WaveformEntry::NumLevels::Unpack(entry);
+		if (num_levels > (reader.GetSize() - reader.GetPos()) / WaveformLevelHeader::Layout::size) throw "Unexpected number of levels in " + reader.GetFilename();
+
+		waveform.levels.resize(num_levels);
+		for (WaveformLevel &level : waveform.levels) {
+			uint8_t level_header[WaveformLevelHeader::Layout::size];
+			reader.ReadRaw(level_header, sizeof(level_header));
+
+			uint32_t num_bins = WaveformLevelHeader::NumBins::Unpack(level_header);
+			if (num_bins > (reader.GetSize() - reader.GetPos()) / sizeof(WaveformBin)) throw "Unexpected number of bins in " + reader.GetFilename();
+
+			level.frames_per_bin = WaveformLevelHeader::FramesPerBin::Unpack(level_header);
+			level.bins.resize(num_bins);
+			reader.ReadRaw((uint8_t *)level.bins.data(), level.bins.size() * sizeof(WaveformBin));
+		}
+
+		waveforms[waveform.hash] = std::move(waveform);
+	}
+	return waveforms;
+}
+
+/**
+ * Write a waveform overview to a waveform file.
+ * @param writer   the waveform file
+ * @param waveform the overview to write
+ */
+static void WriteWaveform(Writer &writer, const Waveform &waveform)
+{
+	uint8_t entry[WaveformEntry::Layout::size];
+	WaveformEntry::Hash::Pack(entry, waveform.hash);
+	WaveformEntry::Frames::Pack(entry, waveform.frames);
+	WaveformEntry::NumLevels::Pack(entry, (uint32_t)waveform.levels.size());
+	writer.WriteRaw(entry, sizeof(entry));
+
+	for (const WaveformLevel &level : waveform.levels) {
+		uint8_t level_header[WaveformLevelHeader::Layout::size];
+		WaveformLevelHeader::FramesPerBin::Pack(level_header, level.frames_per_bin);
+		WaveformLevelHeader::NumBins::Pack(level_header, (uint32_t)level.bins.size());
+		writer.WriteRaw(level_header, sizeof(level_header));
+		writer.WriteRaw((const uint8_t *)level.bins.data(), level.bins.size() * sizeof(WaveformBin));
+	}
+}
+
+void UpdateWaveforms(const std::string &cat_file, const std::string &waveform_file)
+{
+	std::unique_ptr<Reader> cat_reader = OpenCatReader(cat_file);
+	Reader &reader = *cat_reader;
+	Catalogue catalogue(reader);
+	const std::vector<CatEntry> &entries = catalogue.GetEntries();
+
+	std::unique_ptr<FileReader> waveform_reader;
+	try {
+		waveform_reader = std::make_unique<FileReader>(waveform_file);
+	} catch (const std::string &) {
+		/* Without a waveform file yet, all overviews are computed. */
+	}
+
+	std::map<uint64_t, Waveform> existing;
+	if (waveform_reader != nullptr) {
+		existing = ReadWaveforms(*waveform_reader);
+		waveform_reader.reset();
+	}
+
+	std::vector<Waveform> waveforms(entries.size());
+	std::vector<uint8_t> computed(entries.size(), false);
+
+	ParallelRead(reader, entries.size(), [&](Reader &entry_reader, size_t index) {
+		uint64_t hash = HashPayload(entry_reader, entries[index].data_offset, entries[index].size);
+		auto found = existing.find(hash);
+		if (found != existing.end()) {
+			waveforms[index] = found->second;
+			return;
+		}
+
+		/* Only changed samples are decoded. */
+		entry_reader.Seek(index * CatHeaderEntry::Layout::size);
+		Sample sample(entry_reader);
+		entry_reader.Seek(sample.GetOffset());
+		if (catalogue.IsNewFormat()) {
+			sample.ReadCatEntry<true>(entry_reader, (uint32_t)index);
+		} else {
+			sample.ReadCatEntry<false>(entry_reader, (uint32_t)index);
+		}
+
+		const std::vector<uint8_t> &data = sample.GetSampleData();
+		uint16_t bits_per_sample = sample.GetNumChannels() == 0 ? 8 : sample.GetBitsPerSample();
+
+		Waveform &waveform = waveforms[index];
+		waveform.hash = hash;
+		waveform.frames = bits_per_sample == 16 ? data.size() / 2 : data.size();
+		waveform.levels = ComputeWaveform(data.data(), data.size(), bits_per_sample);
+		computed[index] = true;
+	});
+
+	FileWriter writer(waveform_file);
+	uint8_t header[WaveformHeader::Layout::size];
+	WaveformHeader::Layout::PackFixed(header);
+	WaveformHeader::NumEntries::Pack(header, (uint32_t)waveforms.size());
+	writer.WriteRaw(header, sizeof(header));
+	for (const Waveform &waveform : waveforms) WriteWaveform(writer, waveform);
+	writer.Close();
+
+	size_t count = std::count(computed.begin(), computed.end(), (uint8_t)true);
+	printf("%zu waveforms computed, %zu reused\n", count, waveforms.size() - count);
+}
@@ -0,0 +1,36 @@
+/* $Id$ */
+
+/*
+ * catcodec is a tool to decode/encode the sample catalogue for OpenTTD.
+ * Copyright (C) 2009  Remko Bijker
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** @file waveform.hpp Interface for the waveform overviews of cat files */
+
+#ifndef WAVEFORM_HPP
+#define WAVEFORM_HPP
+
+/**
+ * Compute the waveform overviews of all samples of a cat file and write
+ * them to a waveform file. Overviews of samples of which the payload is the
+ * same as in the existing waveform file are taken from that file instead
+ * of computing them again.
+ * @param cat_file      the cat file
+ * @param waveform_file the waveform file to update
+ */
+void UpdateWaveforms(const std::string &cat_file, const std::string &waveform_file);
+
+#endif /* WAVEFORM_HPP */